@@ -6,7 +6,10 @@
 #ifndef ANSWERS_A4HEADER_H
 #define ANSWERS_A4HEADER_H
 
+#include <algorithm>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "SVF-LLVM/SVFIRBuilder.h"
 
@@ -55,26 +58,156 @@ struct CFLREdge
 };
 
 
+/// Finalizer of MurmurHash3: every input bit affects every output bit
+inline uint64_t mixHash64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+
 template<>
 struct std::hash<CFLREdge>
 {
     size_t operator()(const CFLREdge &edge) const
-    { return ((uint64_t) edge.src << 32) | (uint64_t) edge.dst; }
+    { return mixHash64((((uint64_t) edge.src << 32) | (uint64_t) edge.dst) ^ mixHash64(edge.label)); }
+};
+
+
+/**
+ * An edge packed into one 64-bit key: src in bits 35..63, dst in bits 6..34 and the label in bits 0..5
+ */
+using PackedEdge = uint64_t;
+
+constexpr unsigned PackedNodeBits = 29;
+constexpr unsigned PackedLabelBits = 6;
+/// Node IDs of packed edges are below MaxPackedNodes: the all-ones ID is reserved, so that no edge packs to the
+/// all-ones key (CFLREdgeSet's empty slot). CFLR::buildGraph rejects larger graphs.
+constexpr unsigned MaxPackedNodes = (1u << PackedNodeBits) - 1;
+
+inline PackedEdge packEdge(unsigned src, unsigned dst, EdgeLabel label)
+{
+    assert(src < MaxPackedNodes && dst < MaxPackedNodes && label < (1u << PackedLabelBits) &&
+           "edge does not fit in a packed key");
+    return ((uint64_t) src << (PackedNodeBits + PackedLabelBits)) | ((uint64_t) dst << PackedLabelBits) | label;
+}
+
+inline CFLREdge unpackEdge(PackedEdge key)
+{
+    return CFLREdge(key >> (PackedNodeBits + PackedLabelBits),
+                    (key >> PackedLabelBits) & ((1u << PackedNodeBits) - 1),
+                    key & ((1u << PackedLabelBits) - 1));
+}
+
+
+/**
+ * A set of node IDs, kept sorted in one contiguous array.
+ * Up to InlineCap IDs are stored in the object itself; larger sets spill to a heap array that grows geometrically.
+ */
+class CFLRNodeSet
+{
+public:
+    static constexpr unsigned InlineCap = 4;
+
+    CFLRNodeSet() : num(0), cap(InlineCap)
+    {}
+
+    CFLRNodeSet(const CFLRNodeSet &other);
+
+    CFLRNodeSet(CFLRNodeSet &&other) noexcept;
+
+    /// Copy-and-swap: other is a copy (or was moved into), and takes our old array with it
+    inline CFLRNodeSet &operator=(CFLRNodeSet other) noexcept
+    {
+        swap(*this, other);
+        return *this;
+    }
+
+    friend void swap(CFLRNodeSet &lhs, CFLRNodeSet &rhs) noexcept;
+
+    ~CFLRNodeSet()
+    {
+        if (isSpilled())
+            delete[] heap;
+    }
+
+    /// Insert a node ID, return true if it was not in the set
+    bool insert(unsigned id);
+
+    /// Binary search for a node ID
+    inline bool contains(unsigned id) const
+    { return std::binary_search(begin(), end(), id); }
+
+    inline const unsigned *begin() const
+    { return isSpilled() ? heap : inlineBuf; }
+
+    inline const unsigned *end() const
+    { return begin() + num; }
+
+    inline unsigned size() const
+    { return num; }
+
+    inline bool empty() const
+    { return num == 0; }
+
+private:
+    inline bool isSpilled() const
+    { return cap > InlineCap; }
+
+    unsigned num;   // number of IDs
+    unsigned cap;   // capacity of the array in use
+    union
+    {
+        unsigned inlineBuf[InlineCap];
+        unsigned *heap;
+    };
 };
 
 
 /**
  * The graph for CFL-reachability-based pointer analysis
+ *
+ * The edges of the PAG (input edges) never change after construction and are stored in compressed sparse row (CSR)
+ * form, one pair of successor/predecessor arrays per label. Edges added later (derived edges) are stored per node:
+ * a bit mask of the labels the node has edges of, and one CFLRNodeSet per label in the mask, ordered by label.
+ * Either way, the successors (or predecessors) of a node under a label are a contiguous, sorted run of IDs, and
+ * an input edge is never stored again as a derived edge.
  */
 class CFLRGraph
 {
 public:
-    /// We use a source -> label -> target map to represent the adjacency list of the predecessors/successors of nodes.
-    using DataMap = std::unordered_map<unsigned, std::unordered_map<EdgeLabel, std::unordered_set<unsigned>>>;
+    /// Labels are bit positions of the per-node label masks
+    static constexpr unsigned MaxLabels = 64;
+
+    /// A contiguous, sorted run of node IDs
+    struct NodeRange
+    {
+        const unsigned *first;
+        const unsigned *last;
+
+        inline const unsigned *begin() const
+        { return first; }
+
+        inline const unsigned *end() const
+        { return last; }
+
+        inline unsigned size() const
+        { return last - first; }
+
+        inline bool empty() const
+        { return first == last; }
+    };
 
     /// Construct a graph from a PAG
     explicit CFLRGraph(SVF::SVFIR *pag);
 
+    /// Construct a graph from a list of input edges (taken as they are: no reversed edge is added)
+    explicit CFLRGraph(const std::vector<CFLREdge> &edges);
+
     /**
      * Check whether an edge is already in the graph
      * @param src the source node of the edge
@@ -82,72 +215,236 @@ public:
      * @param label the label of the edge
      * @return true of the edge already exists, false otherwise
      */
-    bool hasEdge(unsigned src, unsigned dst, EdgeLabel label);
+    bool hasEdge(unsigned src, unsigned dst, EdgeLabel label) const;
 
     /**
      * Add an edge to the graph
      * @param src the source node of the edge
      * @param dst the target node of the edge
      * @param label the label of the edge
+     * @return true if the edge is new, false if it was already in the graph
      */
-    void addEdge(unsigned src, unsigned dst, EdgeLabel label);
+    bool addEdge(unsigned src, unsigned dst, EdgeLabel label);
+
+    /// addEdge in two halves, for solvers whose threads own disjoint sets of nodes: addSucc records an edge among
+    /// the successors of src (and returns true if the edge is new), addPred among the predecessors of dst; every
+    /// edge for which addSucc returned true must then be passed to addPred. Both nodes must be below getNumNodes().
+    ///@{
+    bool addSucc(unsigned src, unsigned dst, EdgeLabel label);
+    void addPred(unsigned src, unsigned dst, EdgeLabel label);
+    ///@}
+
+    /// Successors/predecessors of a node under a label among the input edges
+    ///@{
+    inline NodeRange getInputSuccs(unsigned node, EdgeLabel label) const
+    { return getRow(inputSuccs, node, label); }
+
+    inline NodeRange getInputPreds(unsigned node, EdgeLabel label) const
+    { return getRow(inputPreds, node, label); }
+    ///@}
+
+    /// Successors/predecessors of a node under a label among the derived edges.
+    /// The range is invalidated by the next addEdge.
+    ///@{
+    inline NodeRange getDerivedSuccs(unsigned node, EdgeLabel label) const
+    { return getSet(derivedSuccs, node, label); }
+
+    inline NodeRange getDerivedPreds(unsigned node, EdgeLabel label) const
+    { return getSet(derivedPreds, node, label); }
+    ///@}
+
+    /// Call f(dst) for every edge (node, dst, label): the input successors first, then the derived ones.
+    /// f must not add edges to the graph.
+    template<class F>
+    inline void forEachSucc(unsigned node, EdgeLabel label, F f) const
+    {
+        for (unsigned dst : getInputSuccs(node, label))
+            f(dst);
+        for (unsigned dst : getDerivedSuccs(node, label))
+            f(dst);
+    }
 
-    DataMap &getSuccessorMap()
-    { return succMap; }
+    /// Call f(src) for every edge (src, node, label): the input predecessors first, then the derived ones.
+    /// f must not add edges to the graph.
+    template<class F>
+    inline void forEachPred(unsigned node, EdgeLabel label, F f) const
+    {
+        for (unsigned src : getInputPreds(node, label))
+            f(src);
+        for (unsigned src : getDerivedPreds(node, label))
+            f(src);
+    }
+
+    /// Nodes are numbered from 0 to getNumNodes() - 1
+    inline unsigned getNumNodes() const
+    { return numNodes; }
+
+    inline size_t getNumInputEdges() const
+    { return numInputEdges; }
+
+    size_t getNumDerivedEdges() const;
+
+protected:
+    /// The input edges of one label in CSR form: the row of node n is targets[offsets[n] .. offsets[n + 1])
+    struct CSR
+    {
+        std::vector<unsigned> offsets;  // empty if there is no edge of this label
+        std::vector<unsigned> targets;
+    };
+
+    /// The derived edges of one node: sets[i] holds the neighbours under the i-th label set in labelMask
+    struct NodeAdj
+    {
+        uint64_t labelMask = 0;
+        std::vector<CFLRNodeSet> sets;
+    };
+
+    /// Record an input edge while the PAG is being read
+    inline void addInputEdge(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        assert(label < MaxLabels && "too many labels");
+        inputEdges.emplace_back(src, dst, label);
+    }
+
+    /// Build the CSR arrays of the input edges, then drop inputEdges
+    void buildInputCSR();
+
+    static NodeRange getRow(const std::vector<CSR> &csrs, unsigned node, EdgeLabel label);
+    static NodeRange getSet(const std::vector<NodeAdj> &adjs, unsigned node, EdgeLabel label);
+    /// Insert node into the set of the given label of adj, return true if it is new
+    static bool insertDerived(NodeAdj &adj, EdgeLabel label, unsigned node);
+
+    unsigned numNodes;
+    size_t numInputEdges;
+    std::vector<CFLREdge> inputEdges;   // input edges before buildInputCSR
+    std::vector<CSR> inputSuccs;        // indexed by label
+    std::vector<CSR> inputPreds;        // indexed by label
+    std::vector<NodeAdj> derivedSuccs;  // indexed by node
+    std::vector<NodeAdj> derivedPreds;  // indexed by node
+};
+
+
+/**
+ * A set of packed edges: an open-addressing hash table with linear probing, whose array doubles when half full
+ */
+class CFLREdgeSet
+{
+public:
+    CFLREdgeSet() : numKeys(0)
+    {}
+
+    inline bool empty() const
+    { return numKeys == 0; }
 
-    DataMap &getPredecessorMap()
-    { return predMap; }
+    inline size_t size() const
+    { return numKeys; }
+
+    /// Remove all keys (keeping the array)
+    void clear();
+
+    /// Insert key, return false if it is already in the set
+    inline bool insert(PackedEdge key)
+    {
+        assert(key != EmptyKey && "the empty key is not an edge");
+        if (2 * (numKeys + 1) > slots.size())
+            grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = mixHash64(key) & mask;; i = (i + 1) & mask)
+        {
+            if (slots[i] == key)
+                return false;
+            if (slots[i] == EmptyKey)
+            {
+                slots[i] = key;
+                numKeys++;
+                return true;
+            }
+        }
+    }
+
+    /// Remove key (if it is in the set)
+    void erase(PackedEdge key);
 
 protected:
-    DataMap predMap;   // holding predecessors
-    DataMap succMap;   // holding successors
+    /// Marks an empty slot (never a packed edge, see MaxPackedNodes)
+    static constexpr PackedEdge EmptyKey = ~(PackedEdge) 0;
+
+    void grow();
+
+    std::vector<PackedEdge> slots;  ///< its size is a power of 2 (or 0)
+    size_t numKeys;
 };
 
 
 /**
- * FIFO worklist
+ * FIFO worklist of CFL-reachability edges, packed into 64-bit keys.
+ * The queue is a ring buffer and the queued keys are also kept in a CFLREdgeSet, so pushing an edge that is already
+ * queued is a no-op; both arrays double when full and never allocate otherwise.
+ * pushUnique skips the set for callers that already know the edge is new (e.g. addEdge returned true): the
+ * edges of the CFLR solver enter the worklist once, when they are added to the graph.
  */
-template<class T>
-class WorkList
+class CFLRWorkList
 {
 public:
+    CFLRWorkList() : head(0), count(0)
+    {}
+
     /// Check whether the worklist is empty.
     inline bool empty() const
-    { return data_list.empty(); }
+    { return count == 0; }
+
+    inline size_t size() const
+    { return count; }
 
     /// Clear the worklist
     inline void clear()
     {
-        data_list.clear();
-        data_set.clear();
+        head = 0;
+        count = 0;
+        queued.clear();
     }
 
-    /// Push a data into the END work list.
-    inline bool push(const T &data)
+    /// Push an edge into the END of the work list, unless it is already queued.
+    inline bool push(const CFLREdge &edge)
     {
-        if (data_set.find(data) == data_set.end())
-        {
-            this->data_list.push_back(data);
-            this->data_set.insert(data);
-            return true;
-        }
-        else
+        PackedEdge key = packEdge(edge.src, edge.dst, edge.label);
+        if (!queued.insert(key))
             return false;
+        enqueue(key);
+        return true;
     }
 
-    /// Pop a data from the FRONT of work list.
-    inline T pop()
+    /// Push an edge known not to be queued (no duplicate check).
+    inline void pushUnique(const CFLREdge &edge)
+    { enqueue(packEdge(edge.src, edge.dst, edge.label)); }
+
+    /// Pop an edge from the FRONT of the work list.
+    inline CFLREdge pop()
     {
         assert(!this->empty() && "work list is empty");
-        T data = this->data_list.front();
-        this->data_list.pop_front();
-        this->data_set.erase(data);
-        return data;
+        PackedEdge key = ring[head];
+        head = (head + 1) & (ring.size() - 1);
+        count--;
+        if (!queued.empty())
+            queued.erase(key);
+        return unpackEdge(key);
     }
 
 protected:
-    std::unordered_set<T> data_set;       ///< to avoid duplicate elements
-    std::deque<T> data_list;     ///< to access the elements at both the beginning and the end
+    inline void enqueue(PackedEdge key)
+    {
+        if (count == ring.size())
+            growRing();
+        ring[(head + count) & (ring.size() - 1)] = key;
+        count++;
+    }
+
+    void growRing();
+
+    std::vector<PackedEdge> ring;   ///< the queue, from ring[head] on (wrapping around); its size is a power of 2
+    size_t head;
+    size_t count;
+    CFLREdgeSet queued;             ///< the keys pushed by push (not pushUnique) and not popped yet
 };
 
 
@@ -156,8 +453,16 @@ protected:
  */
 class CFLR
 {
-    WorkList<CFLREdge> workList;
+    CFLRWorkList workList;
     CFLRGraph *graph;
+    std::vector<unsigned> scratch;  // a copy of the derived neighbours being scanned while edges are added
+
+    /// Add an edge to the graph and, if it is new, to the worklist
+    inline void deriveEdge(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        if (graph->addEdge(src, dst, label))
+            workList.pushUnique(CFLREdge(src, dst, label));
+    }
 
 public:
     CFLR() : graph(nullptr)
@@ -166,12 +471,41 @@ public:
     ~CFLR()
     { delete graph; }
 
+    /// An ordered set of edges: source -> targets
+    using EdgeSet = std::map<unsigned, std::set<unsigned>>;
+
     /// Build a graph from PAG
     void buildGraph(SVF::PAG *pag);
+    /// Build a graph from a list of input edges
+    void buildGraph(const std::vector<CFLREdge> &edges);
+    /// Exit with an error if the nodes of the graph do not fit in packed edges (see MaxPackedNodes)
+    void checkGraphSize() const;
+
+    inline CFLRGraph *getGraph() const
+    { return graph; }
     /// The dynamic-programming CFL-reachability algorithm.
     void solve();
+    /// The worklist algorithm over the normalised productions of Grammar (see CFLRGrammar.h)
+    template<class Grammar>
+    void solveWith();
+    /// Semi-naive CFL-reachability on numThreads threads (0: one per hardware thread), with the result of solve().
+    /// numThreads == 1 runs the semi-naive rounds on the calling thread; the cflr driver uses solve() for
+    /// -cflr-threads=1 instead, as the worklist algorithm is faster on a single thread
+    void solveParallel(unsigned numThreads);
+    /// The semi-naive algorithm over the productions of Grammar (see CFLRParallel.cpp)
+    template<class Grammar>
+    void solveParallelWith(unsigned numThreads);
+    /// CFL-reachability with boolean matrices (one per label), with the result of solve()
+    void solveMatrix();
+    /// The matrix algorithm over the productions of Grammar (see CFLRMatrix.cpp)
+    template<class Grammar>
+    void solveMatrixWith();
+    /// All edges of a label
+    EdgeSet getEdges(EdgeLabel label) const;
     /// Dump results into a file
     void dumpResult();
+    /// Print the solving time and the numbers of edges
+    void printStats(double solveMs);
 };
 
 #endif //ANSWERS_A4HEADER_H
@@ -5,18 +5,92 @@
 
 #include "A4Header.h"
 
-CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
+CFLRNodeSet::CFLRNodeSet(const CFLRNodeSet &other) : num(other.num), cap(InlineCap)
+{
+    if (num > InlineCap)
+    {
+        cap = num;
+        heap = new unsigned[cap];
+    }
+    std::copy(other.begin(), other.end(), isSpilled() ? heap : inlineBuf);
+}
+
+
+CFLRNodeSet::CFLRNodeSet(CFLRNodeSet &&other) noexcept : num(other.num), cap(other.cap)
+{
+    if (other.isSpilled())
+        heap = other.heap;
+    else
+        std::copy(other.inlineBuf, other.inlineBuf + num, inlineBuf);
+    other.num = 0;
+    other.cap = InlineCap;
+}
+
+
+void swap(CFLRNodeSet &lhs, CFLRNodeSet &rhs) noexcept
+{
+    if (lhs.isSpilled() && rhs.isSpilled())
+        std::swap(lhs.heap, rhs.heap);
+    else if (!lhs.isSpilled() && !rhs.isSpilled())
+        std::swap(lhs.inlineBuf, rhs.inlineBuf);
+    else
+    {
+        // one heap array and one inline buffer change places
+        CFLRNodeSet &spilled = lhs.isSpilled() ? lhs : rhs;
+        CFLRNodeSet &inlined = lhs.isSpilled() ? rhs : lhs;
+        unsigned *heap = spilled.heap;
+        unsigned buf[CFLRNodeSet::InlineCap];
+        std::copy(inlined.inlineBuf, inlined.inlineBuf + CFLRNodeSet::InlineCap, buf);
+        std::copy(buf, buf + CFLRNodeSet::InlineCap, spilled.inlineBuf);
+        inlined.heap = heap;
+    }
+    std::swap(lhs.num, rhs.num);
+    std::swap(lhs.cap, rhs.cap);
+}
+
+
+bool CFLRNodeSet::insert(unsigned id)
+{
+    unsigned *data = isSpilled() ? heap : inlineBuf;
+    unsigned *pos = std::lower_bound(data, data + num, id);
+    if (pos != data + num && *pos == id)
+        return false;
+
+    unsigned idx = pos - data;
+    if (num == cap)
+    {
+        // spill to (or grow) the heap array
+        unsigned newCap = cap * 2;
+        unsigned *newData = new unsigned[newCap];
+        std::copy(data, data + idx, newData);
+        std::copy(data + idx, data + num, newData + idx + 1);
+        if (isSpilled())
+            delete[] heap;
+        heap = newData;
+        cap = newCap;
+        data = newData;
+    }
+    else
+        std::copy_backward(data + idx, data + num, data + num + 1);
+    data[idx] = id;
+    num++;
+    return true;
+}
+
+
+CFLRGraph::CFLRGraph(SVF::SVFIR *pag) :
+        numNodes(0), numInputEdges(0)
 {
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Addr))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Addr);
-        addEdge(edge->getDstID(), edge->getSrcID(), AddrBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Addr);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), AddrBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Copy))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Copy);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Phi))
@@ -24,8 +98,8 @@ CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
         const SVF::PhiStmt *phi = SVF::SVFUtil::cast<SVF::PhiStmt>(edge);
         for (const auto opVar : phi->getOpndVars())
         {
-            addEdge(opVar->getId(), phi->getResID(), Copy);
-            addEdge(phi->getResID(), opVar->getId(), CopyBar);
+            addInputEdge(opVar->getId(), phi->getResID(), Copy);
+            addInputEdge(phi->getResID(), opVar->getId(), CopyBar);
         }
     }
 
@@ -34,59 +108,266 @@ CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
         const SVF::SelectStmt *sel = SVF::SVFUtil::cast<SVF::SelectStmt>(edge);
         for (const auto opVar : sel->getOpndVars())
         {
-            addEdge(opVar->getId(), sel->getResID(), Copy);
-            addEdge(sel->getResID(), opVar->getId(), CopyBar);
+            addInputEdge(opVar->getId(), sel->getResID(), Copy);
+            addInputEdge(sel->getResID(), opVar->getId(), CopyBar);
         }
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Call))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Copy);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Ret))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Copy);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::ThreadFork))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Copy);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::ThreadJoin))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Copy);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     // opt load and store
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Store))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Store);
-        addEdge(edge->getDstID(), edge->getSrcID(), StoreBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Store);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), StoreBar);
     }
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Load))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Load);
-        addEdge(edge->getDstID(), edge->getSrcID(), LoadBar);
+        addInputEdge(edge->getSrcID(), edge->getDstID(), Load);
+        addInputEdge(edge->getDstID(), edge->getSrcID(), LoadBar);
+    }
+
+    buildInputCSR();
+}
+
+
+CFLRGraph::CFLRGraph(const std::vector<CFLREdge> &edges) :
+        numNodes(0), numInputEdges(0), inputEdges(edges)
+{
+    buildInputCSR();
+}
+
+
+void CFLRGraph::buildInputCSR()
+{
+    for (const CFLREdge &edge : inputEdges)
+        numNodes = std::max(numNodes, std::max(edge.src, edge.dst) + 1);
+    EdgeLabel numLabels = 0;
+    for (const CFLREdge &edge : inputEdges)
+        numLabels = std::max(numLabels, edge.label + 1);
+    inputSuccs.assign(numLabels, CSR());
+    inputPreds.assign(numLabels, CSR());
+
+    // The (unique) edges are filled in (label, src, dst) order for successors and in (label, dst, src) order for
+    // predecessors, so the rows of a label come one after another and each row is sorted
+    auto fill = [this](std::vector<CSR> &csrs, bool forward)
+    {
+        for (const CFLREdge &edge : inputEdges)
+        {
+            CSR &csr = csrs[edge.label];
+            unsigned from = forward ? edge.src : edge.dst;
+            if (csr.offsets.empty())
+                csr.offsets.assign(numNodes + 1, 0);
+            csr.targets.push_back(forward ? edge.dst : edge.src);
+            csr.offsets[from + 1] = csr.targets.size();
+        }
+        // rows of nodes without edges end where the previous row ends
+        for (CSR &csr : csrs)
+        {
+            for (unsigned n = 1; n < csr.offsets.size(); n++)
+                csr.offsets[n] = std::max(csr.offsets[n], csr.offsets[n - 1]);
+        }
+    };
+
+    std::sort(inputEdges.begin(), inputEdges.end(), [](const CFLREdge &lhs, const CFLREdge &rhs)
+    {
+        if (lhs.label != rhs.label) return lhs.label < rhs.label;
+        return lhs < rhs;
+    });
+    inputEdges.erase(std::unique(inputEdges.begin(), inputEdges.end()), inputEdges.end());
+    numInputEdges = inputEdges.size();
+    fill(inputSuccs, true);
+
+    std::sort(inputEdges.begin(), inputEdges.end(), [](const CFLREdge &lhs, const CFLREdge &rhs)
+    {
+        if (lhs.label != rhs.label) return lhs.label < rhs.label;
+        if (lhs.dst != rhs.dst) return lhs.dst < rhs.dst;
+        return lhs.src < rhs.src;
+    });
+    fill(inputPreds, false);
+
+    std::vector<CFLREdge>().swap(inputEdges);
+    derivedSuccs.resize(numNodes);
+    derivedPreds.resize(numNodes);
+}
+
+
+CFLRGraph::NodeRange CFLRGraph::getRow(const std::vector<CSR> &csrs, unsigned node, EdgeLabel label)
+{
+    if (label >= csrs.size() || node + 1 >= csrs[label].offsets.size())
+        return {nullptr, nullptr};
+    const CSR &csr = csrs[label];
+    const unsigned *targets = csr.targets.data();
+    return {targets + csr.offsets[node], targets + csr.offsets[node + 1]};
+}
+
+
+CFLRGraph::NodeRange CFLRGraph::getSet(const std::vector<NodeAdj> &adjs, unsigned node, EdgeLabel label)
+{
+    if (node >= adjs.size())
+        return {nullptr, nullptr};
+    const NodeAdj &adj = adjs[node];
+    uint64_t bit = (uint64_t) 1 << label;
+    if (!(adj.labelMask & bit))
+        return {nullptr, nullptr};
+    const CFLRNodeSet &set = adj.sets[__builtin_popcountll(adj.labelMask & (bit - 1))];
+    return {set.begin(), set.end()};
+}
+
+
+bool CFLRGraph::insertDerived(NodeAdj &adj, EdgeLabel label, unsigned node)
+{
+    uint64_t bit = (uint64_t) 1 << label;
+    unsigned idx = __builtin_popcountll(adj.labelMask & (bit - 1));
+    if (!(adj.labelMask & bit))
+    {
+        adj.labelMask |= bit;
+        adj.sets.emplace(adj.sets.begin() + idx);
+    }
+    return adj.sets[idx].insert(node);
+}
+
+
+bool CFLRGraph::hasEdge(unsigned int src, unsigned int dst, EdgeLabel label) const
+{
+    NodeRange input = getInputSuccs(src, label);
+    if (std::binary_search(input.begin(), input.end(), dst))
+        return true;
+    NodeRange derived = getDerivedSuccs(src, label);
+    return std::binary_search(derived.begin(), derived.end(), dst);
+}
+
+
+bool CFLRGraph::addEdge(unsigned int src, unsigned int dst, EdgeLabel label)
+{
+    if (std::max(src, dst) >= numNodes)
+    {
+        numNodes = std::max(src, dst) + 1;
+        derivedSuccs.resize(numNodes);
+        derivedPreds.resize(numNodes);
+    }
+    if (!addSucc(src, dst, label))
+        return false;
+    addPred(src, dst, label);
+    return true;
+}
+
+
+bool CFLRGraph::addSucc(unsigned int src, unsigned int dst, EdgeLabel label)
+{
+    assert(label < MaxLabels && "too many labels");
+    assert(src < numNodes && dst < numNodes && "node out of range");
+    NodeRange input = getInputSuccs(src, label);
+    if (std::binary_search(input.begin(), input.end(), dst))
+        return false;
+    return insertDerived(derivedSuccs[src], label, dst);
+}
+
+
+void CFLRGraph::addPred(unsigned int src, unsigned int dst, EdgeLabel label)
+{
+    assert(src < numNodes && dst < numNodes && "node out of range");
+    insertDerived(derivedPreds[dst], label, src);
+}
+
+
+size_t CFLRGraph::getNumDerivedEdges() const
+{
+    size_t num = 0;
+    for (const NodeAdj &adj : derivedSuccs)
+    {
+        for (const CFLRNodeSet &set : adj.sets)
+            num += set.size();
     }
+    return num;
+}
+
+
+void CFLREdgeSet::clear()
+{
+    if (numKeys)
+        std::fill(slots.begin(), slots.end(), EmptyKey);
+    numKeys = 0;
 }
 
 
-bool CFLRGraph::hasEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+void CFLREdgeSet::erase(PackedEdge key)
 {
-    return succMap[src][EdgeLabel].count(dst);
+    if (numKeys == 0)
+        return;
+    size_t mask = slots.size() - 1;
+    size_t i = mixHash64(key) & mask;
+    while (slots[i] != key)
+    {
+        if (slots[i] == EmptyKey)
+            return;
+        i = (i + 1) & mask;
+    }
+    numKeys--;
+
+    // Backward-shift deletion: move later keys of the probe run into the hole if their home slot allows it,
+    // so lookups never stop early at the hole
+    for (size_t j = (i + 1) & mask; slots[j] != EmptyKey; j = (j + 1) & mask)
+    {
+        size_t home = mixHash64(slots[j]) & mask;
+        // slots[j] may move to i iff its home is not cyclically in (i, j]
+        bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable)
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i] = EmptyKey;
 }
 
 
-void CFLRGraph::addEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+void CFLREdgeSet::grow()
 {
-    succMap[src][EdgeLabel].insert(dst);
-    predMap[dst][EdgeLabel].insert(src);
+    std::vector<PackedEdge> oldSlots(slots.empty() ? 128 : slots.size() * 2, EmptyKey);
+    oldSlots.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (PackedEdge key : oldSlots)
+    {
+        if (key == EmptyKey)
+            continue;
+        size_t i = mixHash64(key) & mask;
+        while (slots[i] != EmptyKey)
+            i = (i + 1) & mask;
+        slots[i] = key;
+    }
+}
+
+
+void CFLRWorkList::growRing()
+{
+    std::vector<PackedEdge> newRing(ring.empty() ? 64 : ring.size() * 2);
+    for (size_t k = 0; k < count; k++)
+        newRing[k] = ring[(head + k) & (ring.size() - 1)];
+    ring.swap(newRing);
+    head = 0;
 }
 
 
@@ -94,6 +375,41 @@ void CFLR::buildGraph(SVF::PAG *pag)
 {
     if (!graph)
         graph = new CFLRGraph(pag);
+    checkGraphSize();
+}
+
+
+void CFLR::buildGraph(const std::vector<CFLREdge> &edges)
+{
+    if (!graph)
+        graph = new CFLRGraph(edges);
+    checkGraphSize();
+}
+
+
+void CFLR::checkGraphSize() const
+{
+    // the solvers pack edges into 64-bit keys, which would silently alias the edges of larger graphs
+    if (graph->getNumNodes() > MaxPackedNodes)
+    {
+        std::cerr << "error: the CFL-reachability graph has " << graph->getNumNodes() << " nodes, more than the "
+                  << MaxPackedNodes << " supported\n";
+        std::exit(1);
+    }
+}
+
+
+CFLR::EdgeSet CFLR::getEdges(EdgeLabel label) const
+{
+    EdgeSet edgeSet;
+    for (unsigned src = 0; src < graph->getNumNodes(); src++)
+    {
+        graph->forEachSucc(src, label, [&edgeSet, src](unsigned dst)
+        {
+            edgeSet[src].insert(dst);
+        });
+    }
+    return edgeSet;
 }
 
 
@@ -108,17 +424,7 @@ void CFLR::dumpResult()
     }
 
     // Collect S-edges
-    std::map<unsigned, std::set<unsigned >> edgeSet;  // ordered edge set
-    for (auto &nodeItr : graph->getSuccessorMap())
-    {
-        unsigned src = nodeItr.first;
-        for (auto &lblItr : nodeItr.second)
-        {
-            if (lblItr.first == PT)
-                for (auto dst : lblItr.second)
-                    edgeSet[src].insert(dst);
-        }
-    }
+    EdgeSet edgeSet = getEdges(PT);  // ordered edge set
 
     // Write S-edges
     for (auto &srcItr : edgeSet)
@@ -128,4 +434,11 @@ void CFLR::dumpResult()
             outFile << srcItr.first << '\t' << "points to" << '\t' << dst << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+
+void CFLR::printStats(double solveMs)
+{
+    std::cout << "CFLR solved in " << solveMs << " ms: " << graph->getNumNodes() << " nodes, "
+              << graph->getNumInputEdges() << " input edges, " << graph->getNumDerivedEdges() << " derived edges\n";
+}
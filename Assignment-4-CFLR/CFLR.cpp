@@ -4,11 +4,28 @@
  */
 
 #include "A4Header.h"
+#include <chrono>
 
 using namespace SVF;
 using namespace llvm;
 using namespace std;
 
+static Option<u32_t> NumThreads(
+        "cflr-threads",
+        "Number of threads of the CFL-reachability solver (1: worklist solver, otherwise semi-naive solver; "
+        "0: one thread per hardware thread)",
+        1);
+
+static Option<bool> MatrixSolver(
+        "cflr-matrix",
+        "Solve with boolean adjacency matrices (one per label) instead of the worklist algorithm",
+        false);
+
+static Option<bool> PrintStats(
+        "cflr-stats",
+        "Print the solving time and the numbers of input and derived edges",
+        false);
+
 int main(int argc, char **argv)
 {
     auto moduleNameVec =
@@ -23,20 +40,18 @@ int main(int argc, char **argv)
 
     CFLR solver;
     solver.buildGraph(pag);
-    // TODO: complete this method
-    solver.solve();
+    auto start = chrono::steady_clock::now();
+    if (MatrixSolver())
+        solver.solveMatrix();
+    else if (NumThreads() == 1)  // the worklist solver, not solveParallel(1)
+        solver.solve();
+    else
+        solver.solveParallel(NumThreads());
+    if (PrintStats())
+        solver.printStats(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
     solver.dumpResult();
 
     LLVMModuleSet::releaseLLVMModuleSet();
     return 0;
 }
 
-
-void CFLR::solve()
-{
-    // TODO: complete this function. The implementations of graph and worklist are provided.
-    //  You need to:
-    //  1. implement the grammar production rules into code;
-    //  2. implement the dynamic-programming CFL-reachability algorithm.
-    //  You may need to add your new methods to 'CFLRGraph' and 'CFLR'.
-}
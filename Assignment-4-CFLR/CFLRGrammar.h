@@ -0,0 +1,152 @@
+/**
+ * CFLRGrammar.h
+ * Normalised grammars of CFL-reachability and their production lookup tables, built at compile time.
+ */
+
+#ifndef ANSWERS_CFLRGRAMMAR_H
+#define ANSWERS_CFLRGRAMMAR_H
+
+#include "A4Header.h"
+
+/// The missing right operand of a unary production
+constexpr EdgeLabel NoLabel = ~0u;
+
+/**
+ * A production of a normalised grammar: lhs ::= left right (binary), or lhs ::= left (unary, right == NoLabel)
+ */
+struct CFLRProduction
+{
+    EdgeLabel lhs;
+    EdgeLabel left;
+    EdgeLabel right;
+};
+
+/**
+ * A production fired by a new edge: the label of the derived edge, and the label of the other operand
+ * (NoLabel for unary productions)
+ */
+struct CFLRRule
+{
+    EdgeLabel lhs;
+    EdgeLabel other;
+};
+
+/// The operand of a production a new edge stands for
+enum class CFLROperand
+{
+    Unary,  // the operand of lhs ::= X
+    Left,   // the left operand of lhs ::= X Y
+    Right   // the right operand of lhs ::= Y X
+};
+
+/**
+ * The productions in which each label appears as one operand, grouped by label in CSR form:
+ * the rules fired by a label X are rules[offsets[X] .. offsets[X + 1])
+ */
+template<unsigned NumLabels, size_t NumProds>
+struct CFLRRuleIndex
+{
+    unsigned offsets[NumLabels + 1];
+    CFLRRule rules[NumProds];
+
+    /// A contiguous run of rules
+    struct RuleRange
+    {
+        const CFLRRule *first;
+        const CFLRRule *last;
+
+        inline const CFLRRule *begin() const
+        { return first; }
+
+        inline const CFLRRule *end() const
+        { return last; }
+    };
+
+    inline RuleRange get(EdgeLabel label) const
+    { return {rules + offsets[label], rules + offsets[label + 1]}; }
+};
+
+/// Group the productions by the label of the given operand
+template<unsigned NumLabels, size_t NumProds>
+constexpr CFLRRuleIndex<NumLabels, NumProds> buildRuleIndex(const CFLRProduction (&prods)[NumProds],
+                                                            CFLROperand operand)
+{
+    CFLRRuleIndex<NumLabels, NumProds> index{};
+    unsigned num = 0;
+    for (EdgeLabel label = 0; label < NumLabels; label++)
+    {
+        index.offsets[label] = num;
+        for (const CFLRProduction &prod : prods)
+        {
+            bool unary = prod.right == NoLabel;
+            if (operand == CFLROperand::Unary && unary && prod.left == label)
+                index.rules[num++] = {prod.lhs, NoLabel};
+            else if (operand == CFLROperand::Left && !unary && prod.left == label)
+                index.rules[num++] = {prod.lhs, prod.right};
+            else if (operand == CFLROperand::Right && !unary && prod.right == label)
+                index.rules[num++] = {prod.lhs, prod.left};
+        }
+    }
+    index.offsets[NumLabels] = num;
+    return index;
+}
+
+/**
+ * The lookup tables of a grammar, generated at compile time.
+ * A grammar is a class with the number of labels (NumLabels, labels are 0 .. NumLabels - 1) and an array of
+ * normalised productions (productions).
+ */
+template<class Grammar>
+struct CFLRGrammarTables
+{
+    static constexpr auto unary = buildRuleIndex<Grammar::NumLabels>(Grammar::productions, CFLROperand::Unary);
+    static constexpr auto asLeft = buildRuleIndex<Grammar::NumLabels>(Grammar::productions, CFLROperand::Left);
+    static constexpr auto asRight = buildRuleIndex<Grammar::NumLabels>(Grammar::productions, CFLROperand::Right);
+
+    static_assert(Grammar::NumLabels <= CFLRGraph::MaxLabels, "too many labels");
+};
+
+/**
+ * The grammar of field-insensitive pointer analysis over the labels of EdgeLabelType.
+ * VF is value flow, VA value alias and PT points-to; the productions of the reversed (Bar) labels mirror the others.
+ * The grammar has no epsilon productions:
+ *  - VF ::= epsilon is expanded by hand: a production with a VF operand also appears without it
+ *    (PT ::= AddrBar next to PT ::= VFBar AddrBar, PTBar ::= Addr next to PTBar ::= Addr VF);
+ *  - VA ::= epsilon is replaced by the base case VA ::= PT PTBar, so two pointers alias when they may point to a
+ *    common object (VA ::= VFBar VA VF then extends it along value flows) rather than every node aliasing itself.
+ */
+struct PointerGrammar
+{
+    static constexpr unsigned NumLabels = LVBar + 1;
+
+    static constexpr CFLRProduction productions[] = {
+            {VF,    Copy,    NoLabel},
+            {VFBar, CopyBar, NoLabel},
+            {PT,    AddrBar, NoLabel},
+            {PTBar, Addr,    NoLabel},
+
+            {VF,    VF,      VF},
+            {VFBar, VFBar,   VFBar},
+            {VF,    SV,      Load},
+            {VFBar, LoadBar, SVBar},
+            {VF,    PV,      Load},
+            {VFBar, LoadBar, VP},
+            {VF,    Store,   VP},
+            {VFBar, PV,      StoreBar},
+
+            {PT,    VFBar,   AddrBar},
+            {PTBar, Addr,    VF},
+
+            {VA,    PT,      PTBar},
+            {VA,    VFBar,   VA},
+            {VA,    VA,      VF},
+            {VA,    LV,      Load},
+            {LV,    LoadBar, VA},
+            {SV,    Store,   VA},
+            {SVBar, VA,      StoreBar},
+            {PV,    PTBar,   VA},
+            {VP,    VA,      PT},
+    };
+};
+
+#endif //ANSWERS_CFLRGRAMMAR_H
@@ -0,0 +1,318 @@
+/**
+ * CFLRMatrix.cpp
+ * Matrix-based CFL-reachability: one boolean adjacency matrix per label, and productions evaluated as
+ * matrix products to a fixpoint.
+ */
+
+#include "CFLRGrammar.h"
+#include "CFLRMatrix.h"
+#include <algorithm>
+
+namespace
+{
+
+/// dst |= src over n words. The word kernels are plain loops without intrinsics: any SIMD is the compiler's
+/// auto-vectorisation of them (e.g. at -O3), the restrict pointers keeping it free of aliasing checks
+inline void orWords(uint64_t *__restrict dst, const uint64_t *__restrict src, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++)
+        dst[i] |= src[i];
+}
+
+/// dst &= ~src over n words
+inline void andNotWords(uint64_t *__restrict dst, const uint64_t *__restrict src, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++)
+        dst[i] &= ~src[i];
+}
+
+/// Whether a row with num non-zero words of numWords is stored densely
+inline bool isDenseSize(size_t num, unsigned numWords)
+{
+    return 4 * num >= numWords;
+}
+
+} // anonymous namespace
+
+
+void CFLRBitRow::densify(unsigned numWords)
+{
+    std::vector<uint64_t> dense(numWords, 0);
+    for (unsigned k = 0; k < words.size(); k++)
+        dense[index[k]] = words[k];
+    words.swap(dense);
+    std::vector<unsigned>().swap(index);
+}
+
+
+void CFLRBitRow::unite(const CFLRBitRow &other, unsigned numWords)
+{
+    if (other.empty())
+        return;
+    if (other.isDense())
+    {
+        if (!isDense())
+            densify(numWords);
+        orWords(words.data(), other.words.data(), numWords);
+        return;
+    }
+    if (isDense())
+    {
+        for (unsigned k = 0; k < other.words.size(); k++)
+            words[other.index[k]] |= other.words[k];
+        return;
+    }
+
+    // merge two sparse rows
+    std::vector<uint64_t> mergedWords;
+    std::vector<unsigned> mergedIndex;
+    mergedWords.reserve(words.size() + other.words.size());
+    mergedIndex.reserve(words.size() + other.words.size());
+    unsigned i = 0, j = 0;
+    while (i < words.size() || j < other.words.size())
+    {
+        if (j == other.words.size() || (i < words.size() && index[i] < other.index[j]))
+        {
+            mergedIndex.push_back(index[i]);
+            mergedWords.push_back(words[i++]);
+        }
+        else if (i == words.size() || other.index[j] < index[i])
+        {
+            mergedIndex.push_back(other.index[j]);
+            mergedWords.push_back(other.words[j++]);
+        }
+        else
+        {
+            mergedIndex.push_back(index[i]);
+            mergedWords.push_back(words[i++] | other.words[j++]);
+        }
+    }
+    words.swap(mergedWords);
+    index.swap(mergedIndex);
+    if (isDenseSize(words.size(), numWords))
+        densify(numWords);
+}
+
+
+void CFLRBitAccumulator::add(const CFLRBitRow &row)
+{
+    if (row.isDense())
+    {
+        orWords(acc.data(), row.words.data(), acc.size());
+        allTouched = true;
+        return;
+    }
+    for (unsigned k = 0; k < row.words.size(); k++)
+    {
+        unsigned idx = row.index[k];
+        if (!allTouched && acc[idx] == 0)
+            touched.push_back(idx);
+        acc[idx] |= row.words[k];
+    }
+}
+
+
+void CFLRBitAccumulator::subtract(const CFLRBitRow &row)
+{
+    if (row.isDense())
+    {
+        if (allTouched)
+            andNotWords(acc.data(), row.words.data(), acc.size());
+        else
+        {
+            for (unsigned idx : touched)
+                acc[idx] &= ~row.words[idx];
+        }
+        return;
+    }
+    for (unsigned k = 0; k < row.words.size(); k++)
+        acc[row.index[k]] &= ~row.words[k];
+}
+
+
+bool CFLRBitAccumulator::extract(CFLRBitRow &row)
+{
+    unsigned numWords = acc.size();
+    row.words.clear();
+    row.index.clear();
+    if (allTouched)
+    {
+        size_t num = numWords - std::count(acc.begin(), acc.end(), 0);
+        if (isDenseSize(num, numWords) && num > 0)
+        {
+            row.words.swap(acc);
+            acc.assign(numWords, 0);
+        }
+        else
+        {
+            for (unsigned idx = 0; idx < numWords; idx++)
+            {
+                if (acc[idx])
+                {
+                    row.index.push_back(idx);
+                    row.words.push_back(acc[idx]);
+                    acc[idx] = 0;
+                }
+            }
+        }
+    }
+    else
+    {
+        std::sort(touched.begin(), touched.end());
+        for (unsigned idx : touched)
+        {
+            if (acc[idx])
+            {
+                row.index.push_back(idx);
+                row.words.push_back(acc[idx]);
+                acc[idx] = 0;
+            }
+        }
+        if (isDenseSize(row.words.size(), numWords) && !row.empty())
+            row.densify(numWords);
+    }
+    touched.clear();
+    allTouched = false;
+    return !row.empty();
+}
+
+
+void CFLR::solveMatrix()
+{
+    solveMatrixWith<PointerGrammar>();
+}
+
+
+/*
+ * Semi-naive evaluation: in each round, the rows of every label A gain
+ *   delta(B)                          for each production A ::= B
+ *   delta(B) . full(C)  |  full(B) . delta(C)   for each production A ::= B C
+ * minus full(A), where full(X) holds all edges of label X and delta(X) those added in the previous round.
+ * Row i of full(B) . delta(C) only needs the columns j of full(B)[i] whose delta(C) row is non-empty: they are found
+ * by AND-ing the row with a bit mask of those rows.
+ */
+template<class Grammar>
+void CFLR::solveMatrixWith()
+{
+    assert(graph && "build the graph first");
+    constexpr unsigned NumLabels = Grammar::NumLabels;
+    constexpr unsigned NoRow = ~0u;
+    const unsigned numNodes = graph->getNumNodes();
+    const unsigned numWords = (numNodes + 63) / 64;
+    if (numNodes == 0)
+        return;
+
+    /// A row of a delta matrix
+    struct DeltaRow
+    {
+        unsigned node;
+        CFLRBitRow row;
+    };
+
+    std::vector<std::vector<CFLRProduction>> byLhs(NumLabels);
+    for (const CFLRProduction &prod : Grammar::productions)
+        byLhs[prod.lhs].push_back(prod);
+
+    std::vector<std::vector<CFLRBitRow>> full(NumLabels, std::vector<CFLRBitRow>(numNodes));
+    std::vector<std::vector<DeltaRow>> delta(NumLabels);     // the non-empty rows, by increasing node
+    std::vector<std::vector<DeltaRow>> newDelta(NumLabels);
+    std::vector<std::vector<unsigned>> deltaPos(NumLabels, std::vector<unsigned>(numNodes, NoRow));
+    std::vector<std::vector<uint64_t>> deltaMask(NumLabels, std::vector<uint64_t>(numWords, 0));
+    CFLRBitAccumulator acc(numWords);
+
+    // Every edge already in the graph is a new edge
+    for (EdgeLabel label = 0; label < NumLabels; label++)
+    {
+        for (unsigned node = 0; node < numNodes; node++)
+        {
+            graph->forEachSucc(node, label, [&acc](unsigned dst)
+            {
+                acc.set(dst);
+            });
+            CFLRBitRow row;
+            if (acc.extract(row))
+            {
+                full[label][node] = row;
+                delta[label].push_back({node, std::move(row)});
+            }
+        }
+    }
+
+    while (true)
+    {
+        bool changed = false;
+        for (EdgeLabel label = 0; label < NumLabels; label++)
+        {
+            for (unsigned k = 0; k < delta[label].size(); k++)
+            {
+                unsigned node = delta[label][k].node;
+                deltaPos[label][node] = k;
+                deltaMask[label][node / 64] |= (uint64_t) 1 << (node % 64);
+                changed = true;
+            }
+        }
+        if (!changed)
+            break;
+
+        for (EdgeLabel lhs = 0; lhs < NumLabels; lhs++)
+        {
+            if (byLhs[lhs].empty())
+                continue;
+            for (unsigned node = 0; node < numNodes; node++)
+            {
+                for (const CFLRProduction &prod : byLhs[lhs])
+                {
+                    unsigned pos = deltaPos[prod.left][node];
+                    if (prod.right == NoLabel)
+                    {
+                        if (pos != NoRow)
+                            acc.add(delta[prod.left][pos].row);
+                        continue;
+                    }
+                    const std::vector<CFLRBitRow> &rightFull = full[prod.right];
+                    const std::vector<DeltaRow> &rightDelta = delta[prod.right];
+                    const std::vector<unsigned> &rightPos = deltaPos[prod.right];
+                    if (pos != NoRow)
+                        delta[prod.left][pos].row.forEach([&acc, &rightFull](unsigned mid)
+                        {
+                            acc.add(rightFull[mid]);
+                        });
+                    if (!rightDelta.empty())
+                        full[prod.left][node].forEachAnd(deltaMask[prod.right],
+                                                         [&acc, &rightDelta, &rightPos](unsigned mid)
+                                                         {
+                                                             acc.add(rightDelta[rightPos[mid]].row);
+                                                         });
+                }
+                acc.subtract(full[lhs][node]);
+                CFLRBitRow row;
+                if (acc.extract(row))
+                    newDelta[lhs].push_back({node, std::move(row)});
+            }
+        }
+
+        for (EdgeLabel label = 0; label < NumLabels; label++)
+        {
+            for (const DeltaRow &deltaRow : delta[label])
+                deltaPos[label][deltaRow.node] = NoRow;
+            std::fill(deltaMask[label].begin(), deltaMask[label].end(), 0);
+            for (const DeltaRow &deltaRow : newDelta[label])
+                full[label][deltaRow.node].unite(deltaRow.row, numWords);
+            delta[label].swap(newDelta[label]);
+            newDelta[label].clear();
+        }
+    }
+
+    // Store the derived edges in the graph
+    for (EdgeLabel label = 0; label < NumLabels; label++)
+    {
+        for (unsigned node = 0; node < numNodes; node++)
+            full[label][node].forEach([this, node, label](unsigned dst)
+            {
+                graph->addEdge(node, dst, label);
+            });
+    }
+}
+
+/// Instantiate the solver for the grammars in use
+template void CFLR::solveMatrixWith<PointerGrammar>();
@@ -0,0 +1,102 @@
+/**
+ * CFLRMatrix.h
+ * Bitset rows of the boolean adjacency matrices of the matrix-based CFL-reachability solver.
+ */
+
+#ifndef ANSWERS_CFLRMATRIX_H
+#define ANSWERS_CFLRMATRIX_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A row of a boolean matrix over node IDs: the set of columns, as 64-bit words.
+ * A sparse row keeps its non-zero words only (words[k] is word index[k], in increasing order); once a quarter of
+ * the numWords words of a row are non-zero, the row becomes dense and keeps all of them (index is empty).
+ * Rows only grow. Whole rows are combined with plain word loops, left to the compiler to vectorise.
+ */
+class CFLRBitRow
+{
+public:
+    inline bool empty() const
+    { return words.empty(); }
+
+    inline bool isDense() const
+    { return !words.empty() && index.empty(); }
+
+    /// Call f(column) for every set column, in increasing order
+    template<class F>
+    inline void forEach(F f) const
+    {
+        bool dense = isDense();
+        for (unsigned k = 0; k < words.size(); k++)
+        {
+            unsigned base = (dense ? k : index[k]) * 64;
+            for (uint64_t word = words[k]; word; word &= word - 1)
+                f(base + __builtin_ctzll(word));
+        }
+    }
+
+    /// Call f(column) for every column set in both the row and mask (a dense row of numWords words)
+    template<class F>
+    inline void forEachAnd(const std::vector<uint64_t> &mask, F f) const
+    {
+        bool dense = isDense();
+        for (unsigned k = 0; k < words.size(); k++)
+        {
+            unsigned idx = dense ? k : index[k];
+            for (uint64_t word = words[k] & mask[idx]; word; word &= word - 1)
+                f(idx * 64 + __builtin_ctzll(word));
+        }
+    }
+
+    /// this |= other, for rows of numWords words
+    void unite(const CFLRBitRow &other, unsigned numWords);
+
+private:
+    friend class CFLRBitAccumulator;
+
+    /// Switch to the dense form
+    void densify(unsigned numWords);
+
+    std::vector<uint64_t> words;
+    std::vector<unsigned> index;
+};
+
+
+/**
+ * A dense row being computed: rows are OR-ed into it, then the bits of a row are cleared from it, and the result
+ * is extracted. The words written since the last extraction are tracked, so that building a sparse result costs
+ * the number of words written rather than numWords.
+ */
+class CFLRBitAccumulator
+{
+public:
+    explicit CFLRBitAccumulator(unsigned numWords) : acc(numWords, 0), allTouched(false)
+    {}
+
+    /// Set one column
+    inline void set(unsigned column)
+    {
+        unsigned idx = column / 64;
+        if (!allTouched && acc[idx] == 0)
+            touched.push_back(idx);
+        acc[idx] |= (uint64_t) 1 << (column % 64);
+    }
+
+    /// acc |= row
+    void add(const CFLRBitRow &row);
+
+    /// acc &= ~row
+    void subtract(const CFLRBitRow &row);
+
+    /// Move the set bits into a row (returning false if there is none) and clear the accumulator
+    bool extract(CFLRBitRow &row);
+
+private:
+    std::vector<uint64_t> acc;
+    std::vector<unsigned> touched;  // the indexes of the words that became non-zero (unless allTouched)
+    bool allTouched;                // whether a dense row was added, so any word may be non-zero
+};
+
+#endif //ANSWERS_CFLRMATRIX_H
@@ -0,0 +1,185 @@
+/**
+ * CFLRParallel.cpp
+ * Multi-threaded semi-naive CFL-reachability.
+ *
+ * Each round joins the edges added in the previous round (the delta) against the whole graph, as either operand
+ * of every production. Nodes are owned by threads (node % numThreads), and a round has three phases separated by
+ * barriers:
+ *  1. join: each thread joins the delta edges whose source it owns, and buffers the derived edges that are not in
+ *     the graph (deduplicated in a thread-local set), bucketed by the owner of their source;
+ *  2. merge successors: each thread adds the buffered edges whose source it owns to the successors of their
+ *     source; those that are new form its next delta, and are bucketed by the owner of their target;
+ *  3. merge predecessors: each thread adds the new edges whose target it owns to the predecessors of their target.
+ * The graph is only read in phase 1 and each node is only written by its owner in phases 2 and 3. The solver stops
+ * when a round adds no edge: the graph is then closed under the productions, as after the worklist algorithm.
+ */
+
+#include "CFLRGrammar.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+
+/// A reusable barrier for a fixed number of threads
+class Barrier
+{
+public:
+    explicit Barrier(unsigned n) : numThreads(n), numWaiting(0), generation(0)
+    {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned gen = generation;
+        if (++numWaiting == numThreads)
+        {
+            numWaiting = 0;
+            generation++;
+            cv.notify_all();
+        }
+        else
+            cv.wait(lock, [this, gen]
+            { return gen != generation; });
+    }
+
+private:
+    unsigned numThreads;
+    unsigned numWaiting;
+    unsigned generation;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/// The buffers of one thread
+struct ThreadState
+{
+    std::vector<PackedEdge> delta;                  // the last round's new edges whose source this thread owns
+    std::vector<std::vector<PackedEdge>> derived;   // the edges derived in this round, by owner of their source
+    std::vector<std::vector<PackedEdge>> added;     // the edges added in this round, by owner of their target
+    CFLREdgeSet seen;                               // the edges derived in this round
+};
+
+} // anonymous namespace
+
+
+void CFLR::solveParallel(unsigned numThreads)
+{
+    solveParallelWith<PointerGrammar>(numThreads);
+}
+
+
+template<class Grammar>
+void CFLR::solveParallelWith(unsigned numThreads)
+{
+    typedef CFLRGrammarTables<Grammar> Tables;
+    assert(graph && "build the graph first");
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    CFLRGraph *g = graph;
+    std::vector<ThreadState> states(numThreads);
+    for (ThreadState &state : states)
+    {
+        state.derived.resize(numThreads);
+        state.added.resize(numThreads);
+    }
+    Barrier barrier(numThreads);
+    std::atomic<size_t> numAdded(0);
+
+    auto run = [&](unsigned t)
+    {
+        ThreadState &state = states[t];
+
+        // Every edge already in the graph is a new edge
+        for (unsigned src = t; src < g->getNumNodes(); src += numThreads)
+        {
+            for (EdgeLabel label = 0; label < Grammar::NumLabels; label++)
+                g->forEachSucc(src, label, [&state, src, label](unsigned dst)
+                {
+                    state.delta.push_back(packEdge(src, dst, label));
+                });
+        }
+
+        auto derive = [&](unsigned src, unsigned dst, EdgeLabel label)
+        {
+            if (g->hasEdge(src, dst, label))
+                return;
+            PackedEdge key = packEdge(src, dst, label);
+            if (state.seen.insert(key))
+                state.derived[src % numThreads].push_back(key);
+        };
+
+        while (true)
+        {
+            // 1. join the delta against the graph
+            for (PackedEdge key : state.delta)
+            {
+                CFLREdge edge = unpackEdge(key);
+                for (const CFLRRule &rule : Tables::unary.get(edge.label))
+                    derive(edge.src, edge.dst, rule.lhs);
+                for (const CFLRRule &rule : Tables::asLeft.get(edge.label))
+                    g->forEachSucc(edge.dst, rule.other, [&derive, &edge, &rule](unsigned succ)
+                    {
+                        derive(edge.src, succ, rule.lhs);
+                    });
+                for (const CFLRRule &rule : Tables::asRight.get(edge.label))
+                    g->forEachPred(edge.src, rule.other, [&derive, &edge, &rule](unsigned pred)
+                    {
+                        derive(pred, edge.dst, rule.lhs);
+                    });
+            }
+            state.delta.clear();
+            state.seen.clear();
+            barrier.wait();
+
+            // 2. add the derived edges whose source this thread owns
+            for (ThreadState &other : states)
+            {
+                for (PackedEdge key : other.derived[t])
+                {
+                    CFLREdge edge = unpackEdge(key);
+                    if (g->addSucc(edge.src, edge.dst, edge.label))
+                    {
+                        state.delta.push_back(key);
+                        state.added[edge.dst % numThreads].push_back(key);
+                    }
+                }
+                other.derived[t].clear();
+            }
+            numAdded += state.delta.size();
+            barrier.wait();
+
+            // 3. add the new edges whose target this thread owns to the predecessors
+            size_t roundAdded = numAdded.load();
+            for (ThreadState &other : states)
+            {
+                for (PackedEdge key : other.added[t])
+                {
+                    CFLREdge edge = unpackEdge(key);
+                    g->addPred(edge.src, edge.dst, edge.label);
+                }
+                other.added[t].clear();
+            }
+            barrier.wait();
+
+            if (roundAdded == 0)
+                break;
+            // every thread has read numAdded before the last barrier
+            if (t == 0)
+                numAdded = 0;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < numThreads; t++)
+        workers.emplace_back(run, t);
+    run(0);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+/// Instantiate the solver for the grammars in use
+template void CFLR::solveParallelWith<PointerGrammar>(unsigned numThreads);
@@ -0,0 +1,62 @@
+/**
+ * CFLRSolver.cpp
+ * Worklist CFL-reachability over the compile-time tables of a grammar.
+ */
+
+#include "CFLRGrammar.h"
+
+void CFLR::solve()
+{
+    solveWith<PointerGrammar>();
+}
+
+
+template<class Grammar>
+void CFLR::solveWith()
+{
+    typedef CFLRGrammarTables<Grammar> Tables;
+
+    // Every edge already in the graph is a new edge
+    for (unsigned src = 0; src < graph->getNumNodes(); src++)
+    {
+        for (EdgeLabel label = 0; label < Grammar::NumLabels; label++)
+            graph->forEachSucc(src, label, [this, src, label](unsigned dst)
+            {
+                workList.pushUnique(CFLREdge(src, dst, label));
+            });
+    }
+
+    while (!workList.empty())
+    {
+        CFLREdge edge = workList.pop();
+        assert(edge.label < Grammar::NumLabels && "label not in grammar");
+
+        // lhs ::= label
+        for (const CFLRRule &rule : Tables::unary.get(edge.label))
+            deriveEdge(edge.src, edge.dst, rule.lhs);
+
+        // lhs ::= label other: src --label--> dst --other--> succ
+        for (const CFLRRule &rule : Tables::asLeft.get(edge.label))
+        {
+            for (unsigned succ : graph->getInputSuccs(edge.dst, rule.other))
+                deriveEdge(edge.src, succ, rule.lhs);
+            CFLRGraph::NodeRange derived = graph->getDerivedSuccs(edge.dst, rule.other);
+            scratch.assign(derived.begin(), derived.end());
+            for (unsigned succ : scratch)
+                deriveEdge(edge.src, succ, rule.lhs);
+        }
+
+        // lhs ::= other label: pred --other--> src --label--> dst
+        for (const CFLRRule &rule : Tables::asRight.get(edge.label))
+        {
+            for (unsigned pred : graph->getInputPreds(edge.src, rule.other))
+                deriveEdge(pred, edge.dst, rule.lhs);
+            CFLRGraph::NodeRange derived = graph->getDerivedPreds(edge.src, rule.other);
+            scratch.assign(derived.begin(), derived.end());
+            for (unsigned pred : scratch)
+                deriveEdge(pred, edge.dst, rule.lhs);
+        }
+    }
+}
+
+template void CFLR::solveWith<PointerGrammar>();
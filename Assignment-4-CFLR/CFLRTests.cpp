@@ -0,0 +1,508 @@
+/**
+ * CFLRTests.cpp
+ * Behaviour checks of the CFL-reachability graph, worklist and solvers, on graphs built from edge lists.
+ */
+
+#include "CFLRGrammar.h"
+#include "CFLRMatrix.h"
+#include <deque>
+#include <random>
+#include <tuple>
+
+namespace
+{
+
+unsigned numFailed = 0;
+
+/// Report a failed check (kept under NDEBUG, unlike assert)
+#define CHECK(cond) \
+    do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; numFailed++; } } while (0)
+
+using EdgeTriple = std::tuple<unsigned, unsigned, EdgeLabel>;
+
+/// Random input edges over numNodes nodes and labels below numLabels
+std::vector<CFLREdge> randomEdges(std::mt19937 &rng, unsigned numNodes, unsigned numEdges, unsigned numLabels)
+{
+    std::vector<CFLREdge> edges;
+    for (unsigned i = 0; i < numEdges; i++)
+        edges.emplace_back(rng() % numNodes, rng() % numNodes, rng() % numLabels);
+    return edges;
+}
+
+/// The successors (or predecessors) of a node under a label, as reported by the graph
+std::vector<unsigned> neighbours(const CFLRGraph &graph, unsigned node, EdgeLabel label, bool succ)
+{
+    std::vector<unsigned> nodes;
+    auto collect = [&nodes](unsigned n)
+    { nodes.push_back(n); };
+    if (succ)
+        graph.forEachSucc(node, label, collect);
+    else
+        graph.forEachPred(node, label, collect);
+    return nodes;
+}
+
+/// CFLRGraph against a std::set of edges: input edges, derived edges, hasEdge/addEdge and the neighbour ranges
+void testGraph()
+{
+    std::mt19937 rng(1);
+    for (unsigned round = 0; round < 20; round++)
+    {
+        unsigned numNodes = 4 + rng() % 60;
+        std::vector<CFLREdge> input = randomEdges(rng, numNodes, 3 * numNodes, 8);
+        std::set<EdgeTriple> model;
+        for (const CFLREdge &edge : input)
+            model.insert(EdgeTriple(edge.src, edge.dst, edge.label));
+        CFLRGraph graph(input);
+        CHECK(graph.getNumInputEdges() == model.size());
+
+        // derived edges, including nodes beyond the input ones and edges that are already input edges
+        for (unsigned i = 0; i < 2000; i++)
+        {
+            unsigned src = rng() % (numNodes + 4), dst = rng() % (numNodes + 4);
+            EdgeLabel label = rng() % 22;
+            bool isNew = !model.count(EdgeTriple(src, dst, label));
+            CHECK(graph.hasEdge(src, dst, label) == !isNew);
+            CHECK(graph.addEdge(src, dst, label) == isNew);
+            CHECK(graph.hasEdge(src, dst, label));
+            model.insert(EdgeTriple(src, dst, label));
+        }
+        CHECK(graph.getNumInputEdges() + graph.getNumDerivedEdges() == model.size());
+
+        for (unsigned node = 0; node < graph.getNumNodes(); node++)
+        {
+            for (EdgeLabel label = 0; label < 22; label++)
+            {
+                std::vector<unsigned> succs, preds;
+                for (const EdgeTriple &edge : model)
+                {
+                    if (std::get<0>(edge) == node && std::get<2>(edge) == label)
+                        succs.push_back(std::get<1>(edge));
+                    if (std::get<1>(edge) == node && std::get<2>(edge) == label)
+                        preds.push_back(std::get<0>(edge));
+                }
+                std::sort(preds.begin(), preds.end());
+
+                // input and derived runs are sorted and disjoint
+                CFLRGraph::NodeRange in = graph.getInputSuccs(node, label);
+                CFLRGraph::NodeRange derived = graph.getDerivedSuccs(node, label);
+                CHECK(std::is_sorted(in.begin(), in.end()) && std::is_sorted(derived.begin(), derived.end()));
+                std::vector<unsigned> both;
+                std::set_intersection(in.begin(), in.end(), derived.begin(), derived.end(), std::back_inserter(both));
+                CHECK(both.empty());
+
+                std::vector<unsigned> gotSuccs = neighbours(graph, node, label, true);
+                std::vector<unsigned> gotPreds = neighbours(graph, node, label, false);
+                std::sort(gotSuccs.begin(), gotSuccs.end());
+                std::sort(gotPreds.begin(), gotPreds.end());
+                CHECK(gotSuccs == succs);
+                CHECK(gotPreds == preds);
+            }
+        }
+    }
+}
+
+/// CFLRNodeSet: sorted inserts across the inline/heap boundary, copies, moves and swaps
+void testNodeSet()
+{
+    std::mt19937 rng(2);
+    for (unsigned round = 0; round < 200; round++)
+    {
+        CFLRNodeSet set;
+        std::set<unsigned> model;
+        unsigned num = rng() % (3 * CFLRNodeSet::InlineCap);
+        for (unsigned i = 0; i < num; i++)
+        {
+            unsigned id = rng() % 20;
+            CHECK(set.insert(id) == model.insert(id).second);
+            CHECK(set.contains(id));
+        }
+        CHECK(std::equal(set.begin(), set.end(), model.begin(), model.end()));
+
+        CFLRNodeSet small;
+        small.insert(7);
+        CFLRNodeSet copy(set);
+        swap(small, copy);
+        CHECK(std::equal(small.begin(), small.end(), model.begin(), model.end()));
+        CHECK(copy.size() == 1 && *copy.begin() == 7);
+        copy = small;
+        CFLRNodeSet moved(std::move(small));
+        CHECK(small.empty());
+        CHECK(std::equal(copy.begin(), copy.end(), moved.begin(), moved.end()));
+        moved = CFLRNodeSet();
+        CHECK(moved.empty() && !moved.contains(7));
+    }
+}
+
+/// Packed keys, the label-aware edge hash, CFLREdgeSet and CFLRWorkList against std containers
+void testWorkList()
+{
+    // packing round-trips up to the largest node ID, and never produces the empty-slot key
+    unsigned maxID = MaxPackedNodes - 1;
+    CFLREdge corner(maxID, maxID, (1u << PackedLabelBits) - 1);
+    CHECK(unpackEdge(packEdge(corner.src, corner.dst, corner.label)) == corner);
+    CHECK(packEdge(maxID, maxID, corner.label) != ~(PackedEdge) 0);
+    CHECK(unpackEdge(packEdge(5, 0, 21)) == CFLREdge(5, 0, 21));
+
+    // edges between the same endpoints with different labels hash apart
+    std::set<size_t> hashes;
+    for (EdgeLabel label = 0; label < 22; label++)
+        hashes.insert(std::hash<CFLREdge>()(CFLREdge(3, 4, label)));
+    CHECK(hashes.size() == 22);
+
+    std::mt19937 rng(3);
+    for (unsigned round = 0; round < 50; round++)
+    {
+        unsigned range = 1 + rng() % 100;
+        CFLREdgeSet set;
+        std::set<PackedEdge> setModel;
+        CFLRWorkList workList;
+        std::deque<CFLREdge> queueModel;
+        std::set<EdgeTriple> queuedModel;
+        for (unsigned i = 0; i < 5000; i++)
+        {
+            CFLREdge edge(rng() % range, rng() % range, rng() % 22);
+            PackedEdge key = packEdge(edge.src, edge.dst, edge.label);
+            switch (rng() % 6)
+            {
+            case 0:
+                set.erase(key);
+                setModel.erase(key);
+                break;
+            case 1:
+            case 2:
+                CHECK(set.insert(key) == setModel.insert(key).second);
+                break;
+            case 3:
+            case 4:
+            {
+                bool isNew = queuedModel.insert(EdgeTriple(edge.src, edge.dst, edge.label)).second;
+                CHECK(workList.push(edge) == isNew);
+                if (isNew)
+                    queueModel.push_back(edge);
+                break;
+            }
+            default:
+                CHECK(workList.empty() == queueModel.empty());
+                if (!queueModel.empty())
+                {
+                    CFLREdge front = queueModel.front();
+                    queueModel.pop_front();
+                    queuedModel.erase(EdgeTriple(front.src, front.dst, front.label));
+                    CHECK(workList.pop() == front);
+                }
+            }
+            CHECK(set.size() == setModel.size());
+            CHECK(workList.size() == queueModel.size());
+        }
+        // every remaining key is still found after the backward-shift deletions
+        for (PackedEdge key : setModel)
+            CHECK(!set.insert(key));
+        while (!queueModel.empty())
+        {
+            CHECK(workList.pop() == queueModel.front());
+            queueModel.pop_front();
+        }
+        CHECK(workList.empty());
+    }
+}
+
+/// The rules of a grammar table for one label, sorted
+template<class Index>
+std::vector<std::pair<EdgeLabel, EdgeLabel>> rulesOf(const Index &index, EdgeLabel label)
+{
+    std::vector<std::pair<EdgeLabel, EdgeLabel>> rules;
+    for (const CFLRRule &rule : index.get(label))
+        rules.emplace_back(rule.lhs, rule.other);
+    std::sort(rules.begin(), rules.end());
+    return rules;
+}
+
+/// The input edges of PAG edges of the given kind (Addr, Copy, Store or Load) and of their reversed edges
+void addPAGEdge(std::vector<CFLREdge> &edges, EdgeLabel kind, unsigned src, unsigned dst)
+{
+    edges.emplace_back(src, dst, kind);
+    edges.emplace_back(dst, src, kind + 1);
+}
+
+/// The points-to edges found by the worklist solver
+CFLR::EdgeSet solvePT(const std::vector<CFLREdge> &edges)
+{
+    CFLR solver;
+    solver.buildGraph(edges);
+    solver.solve();
+    return solver.getEdges(PT);
+}
+
+/// The tables of PointerGrammar hold exactly its productions, and the solver finds the points-to sets of small PAGs
+void testGrammar()
+{
+    typedef CFLRGrammarTables<PointerGrammar> Tables;
+
+    unsigned numUnary = 0, numBinary = 0;
+    for (const CFLRProduction &prod : PointerGrammar::productions)
+        (prod.right == NoLabel ? numUnary : numBinary)++;
+    CHECK(numUnary == 4 && numBinary == 19);
+    CHECK(Tables::unary.offsets[PointerGrammar::NumLabels] == numUnary);
+    CHECK(Tables::asLeft.offsets[PointerGrammar::NumLabels] == numBinary);
+    CHECK(Tables::asRight.offsets[PointerGrammar::NumLabels] == numBinary);
+
+    for (EdgeLabel label = 0; label < PointerGrammar::NumLabels; label++)
+    {
+        std::vector<std::pair<EdgeLabel, EdgeLabel>> unary, asLeft, asRight;
+        for (const CFLRProduction &prod : PointerGrammar::productions)
+        {
+            if (prod.right == NoLabel && prod.left == label)
+                unary.emplace_back(prod.lhs, NoLabel);
+            if (prod.right != NoLabel && prod.left == label)
+                asLeft.emplace_back(prod.lhs, prod.right);
+            if (prod.right != NoLabel && prod.right == label)
+                asRight.emplace_back(prod.lhs, prod.left);
+        }
+        std::sort(unary.begin(), unary.end());
+        std::sort(asLeft.begin(), asLeft.end());
+        std::sort(asRight.begin(), asRight.end());
+        CHECK(rulesOf(Tables::unary, label) == unary);
+        CHECK(rulesOf(Tables::asLeft, label) == asLeft);
+        CHECK(rulesOf(Tables::asRight, label) == asRight);
+    }
+    CHECK(rulesOf(Tables::unary, AddrBar) == (std::vector<std::pair<EdgeLabel, EdgeLabel>>{{PT, NoLabel}}));
+    CHECK(rulesOf(Tables::asRight, AddrBar) == (std::vector<std::pair<EdgeLabel, EdgeLabel>>{{PT, VFBar}}));
+    CHECK(rulesOf(Tables::unary, Load).empty());
+
+    // nodes: objects a = 0, b = 1, c = 2; pointers p = 10, q = 11, r = 12, x = 13, y = 14
+    std::vector<CFLREdge> edges;
+
+    // p = &a
+    addPAGEdge(edges, Addr, 0, 10);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{10, {0}}}));
+
+    // p = &a; q = p
+    addPAGEdge(edges, Copy, 10, 11);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{10, {0}}, {11, {0}}}));
+
+    // p = &a; q = p; x = &b; *p = x; y = *q: object a points to b, and the load through the alias q reads it
+    addPAGEdge(edges, Addr, 1, 13);
+    addPAGEdge(edges, Store, 13, 10);
+    addPAGEdge(edges, Load, 11, 14);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{0, {1}}, {10, {0}}, {11, {0}}, {13, {1}}, {14, {1}}}));
+
+    // ... r = &c; y = *r: r does not alias p, so y still only points to b
+    addPAGEdge(edges, Addr, 2, 12);
+    addPAGEdge(edges, Load, 12, 14);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{0, {1}}, {10, {0}}, {11, {0}}, {12, {2}}, {13, {1}}, {14, {1}}}));
+
+    // ... r = q: r points to a and c and aliases p, so *p = x also stores b into c (VF ::= Store VP)
+    addPAGEdge(edges, Copy, 11, 12);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{0, {1}}, {2, {1}}, {10, {0}}, {11, {0}}, {12, {0, 2}}, {13, {1}},
+                                           {14, {1}}}));
+
+    // ... *r = r: a and c now point to a and c, and through the aliases this creates every object points to a, b, c
+    addPAGEdge(edges, Store, 12, 12);
+    CHECK(solvePT(edges) == (CFLR::EdgeSet{{0, {0, 1, 2}}, {1, {0, 1, 2}}, {2, {0, 1, 2}}, {10, {0}}, {11, {0}},
+                                           {12, {0, 2}}, {13, {1}}, {14, {0, 1, 2}}}));
+}
+
+/// A random PAG of numNodes nodes: numEdges Addr, Copy, Store and Load edges with their reversed edges
+std::vector<CFLREdge> randomPAG(std::mt19937 &rng, unsigned numNodes, unsigned numEdges)
+{
+    static const EdgeLabel kinds[] = {Addr, Copy, Copy, Store, Load};
+    std::vector<CFLREdge> edges;
+    for (unsigned i = 0; i < numEdges; i++)
+        addPAGEdge(edges, kinds[rng() % 5], rng() % numNodes, rng() % numNodes);
+    return edges;
+}
+
+/// Every edge of the graph of a solver, for all the labels of PointerGrammar
+std::vector<CFLR::EdgeSet> allEdges(const CFLR &solver)
+{
+    std::vector<CFLR::EdgeSet> edges;
+    for (EdgeLabel label = 0; label < PointerGrammar::NumLabels; label++)
+        edges.push_back(solver.getEdges(label));
+    return edges;
+}
+
+/// The semi-naive solver on 1, 2 and 4 threads derives the same edges as the worklist solver
+void testParallel()
+{
+    std::mt19937 rng(4);
+    for (unsigned round = 0; round < 20; round++)
+    {
+        unsigned numNodes = 5 + rng() % 80;
+        std::vector<CFLREdge> input = randomPAG(rng, numNodes, numNodes + rng() % (2 * numNodes));
+
+        CFLR worklist;
+        worklist.buildGraph(input);
+        worklist.solve();
+        std::vector<CFLR::EdgeSet> expected = allEdges(worklist);
+
+        for (unsigned numThreads : {1u, 2u, 4u})
+        {
+            CFLR parallel;
+            parallel.buildGraph(input);
+            parallel.solveParallel(numThreads);
+            CHECK(allEdges(parallel) == expected);
+        }
+    }
+}
+
+/// A bit row holding the given columns, built through an accumulator
+CFLRBitRow makeRow(const std::set<unsigned> &columns, unsigned numWords)
+{
+    CFLRBitAccumulator acc(numWords);
+    for (unsigned column : columns)
+        acc.set(column);
+    CFLRBitRow row;
+    CHECK(acc.extract(row) == !columns.empty());
+    return row;
+}
+
+/// The columns of a bit row
+std::set<unsigned> columnsOf(const CFLRBitRow &row)
+{
+    std::set<unsigned> columns;
+    std::vector<unsigned> ordered;
+    row.forEach([&ordered](unsigned column)
+                { ordered.push_back(column); });
+    CHECK(std::is_sorted(ordered.begin(), ordered.end()));
+    columns.insert(ordered.begin(), ordered.end());
+    return columns;
+}
+
+/// Random columns of numWords words, in 1 to numWords of the words
+std::set<unsigned> randomColumns(std::mt19937 &rng, unsigned numWords)
+{
+    std::set<unsigned> columns;
+    unsigned numUsed = rng() % (numWords + 1);
+    for (unsigned i = 0; i < numUsed; i++)
+    {
+        unsigned word = rng() % numWords;
+        for (unsigned bits = 1 + rng() % 8; bits > 0; bits--)
+            columns.insert(word * 64 + rng() % 64);
+    }
+    return columns;
+}
+
+/// CFLRBitRow and CFLRBitAccumulator on mixes of sparse and dense rows, against std::set
+void testBitRows()
+{
+    std::mt19937 rng(5);
+    for (unsigned round = 0; round < 500; round++)
+    {
+        unsigned numWords = 1 + rng() % 24;
+        std::set<unsigned> a = randomColumns(rng, numWords), b = randomColumns(rng, numWords);
+        CFLRBitRow rowA = makeRow(a, numWords), rowB = makeRow(b, numWords);
+        CHECK(columnsOf(rowA) == a && columnsOf(rowB) == b);
+
+        std::set<unsigned> words;
+        for (unsigned column : a)
+            words.insert(column / 64);
+        CHECK(rowA.isDense() == (!a.empty() && 4 * words.size() >= numWords));
+
+        // unite, in both orders
+        std::set<unsigned> both(a);
+        both.insert(b.begin(), b.end());
+        CFLRBitRow ab = rowA, ba = rowB;
+        ab.unite(rowB, numWords);
+        ba.unite(rowA, numWords);
+        CHECK(columnsOf(ab) == both && columnsOf(ba) == both);
+
+        // forEachAnd with b as the mask
+        std::vector<uint64_t> mask(numWords, 0);
+        for (unsigned column : b)
+            mask[column / 64] |= (uint64_t) 1 << (column % 64);
+        std::set<unsigned> common, expected;
+        rowA.forEachAnd(mask, [&common](unsigned column)
+                        { common.insert(column); });
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::inserter(expected, expected.end()));
+        CHECK(common == expected);
+
+        // (a | b | c) & ~d, with the rows added in a random order, then the accumulator is reused
+        std::set<unsigned> c = randomColumns(rng, numWords), d = randomColumns(rng, numWords);
+        CFLRBitRow rowD = makeRow(d, numWords);
+        CFLRBitAccumulator acc(numWords);
+        for (unsigned use = 0; use < 2; use++)
+        {
+            if (rng() % 2)
+            {
+                acc.add(rowA);
+                acc.add(rowB);
+            }
+            else
+            {
+                acc.add(rowB);
+                acc.add(rowA);
+            }
+            for (unsigned column : c)
+                acc.set(column);
+            acc.subtract(rowD);
+            std::set<unsigned> result(both);
+            result.insert(c.begin(), c.end());
+            for (unsigned column : d)
+                result.erase(column);
+            CFLRBitRow row;
+            CHECK(acc.extract(row) == !result.empty());
+            CHECK(columnsOf(row) == result);
+        }
+        CFLRBitRow none;
+        CHECK(!acc.extract(none) && none.empty());
+    }
+}
+
+/// The matrix solver derives the same edges as the worklist solver, on graphs dense enough for dense rows
+void testMatrix()
+{
+    std::mt19937 rng(6);
+    for (unsigned round = 0; round < 12; round++)
+    {
+        unsigned numNodes = 2 + rng() % 200;
+        std::vector<CFLREdge> input = randomPAG(rng, numNodes, numNodes + rng() % (3 * numNodes));
+
+        CFLR worklist, matrix;
+        worklist.buildGraph(input);
+        worklist.solve();
+        matrix.buildGraph(input);
+        matrix.solveMatrix();
+        CHECK(allEdges(matrix) == allEdges(worklist));
+    }
+
+    // objects 0..127 and pointers 200..216 (four words of columns): 200..203 point to 32 objects each, 204..215 to
+    // all of them, and through *200 = 215 and 216 = *200 the objects of 200 and the pointer 216 too, in dense PT rows
+    std::vector<CFLREdge> input;
+    for (unsigned obj = 0; obj < 128; obj++)
+        addPAGEdge(input, Addr, obj, 200 + obj % 4);
+    for (unsigned ptr = 200; ptr < 204; ptr++)
+        addPAGEdge(input, Copy, ptr, 204);
+    for (unsigned ptr = 204; ptr < 215; ptr++)
+        addPAGEdge(input, Copy, ptr, ptr + 1);
+    addPAGEdge(input, Store, 215, 200);
+    addPAGEdge(input, Load, 200, 216);
+    CFLR worklist, matrix;
+    worklist.buildGraph(input);
+    worklist.solve();
+    matrix.buildGraph(input);
+    matrix.solveMatrix();
+    CFLR::EdgeSet pointsTo = worklist.getEdges(PT);
+    CHECK(pointsTo[0].size() == 128 && pointsTo[216].size() == 128 && pointsTo[201].size() == 32);
+    CHECK(allEdges(matrix) == allEdges(worklist));
+}
+
+} // anonymous namespace
+
+int main()
+{
+    testGraph();
+    testNodeSet();
+    testWorkList();
+    testGrammar();
+    testParallel();
+    testBitRows();
+    testMatrix();
+    if (numFailed)
+    {
+        std::cerr << numFailed << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "all CFLR tests passed\n";
+    return 0;
+}
@@ -0,0 +1,201 @@
+/**
+ * Z3Bench.cpp
+ * Compare the Int/BV32/BV64 encodings of GenericZ3Mgr on the test programs of Z3Tests.cpp
+ * and on larger generated store/load programs, the memory models on the generated programs, and checking
+ * assertions one by one with a Z3MgrPool.
+ *
+ * Usage: z3bench [numObjs] [numOps] [repeats], each a positive count
+ * The solvers are configured by the environment variable Z3MGR_SOLVER_CONFIG (see Z3SolverConfig).
+ */
+
+#include "Z3Mgr.h"
+#include "Z3MgrPool.h"
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace SVF;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+/// Run test0 ~ test10 of Z3Tests.cpp (their output is discarded), with full or lightweight resets between them
+template<class Encoding>
+static double runTests(u32_t repeats, bool lightReset)
+{
+    std::stringstream sink;
+    std::streambuf *coutBuf = std::cout.rdbuf(sink.rdbuf());
+    Clock::time_point start = Clock::now();
+    for (u32_t r = 0; r < repeats; r++)
+    {
+        GenericZ3Tests<Encoding> tests;
+        tests.setLightweightReset(lightReset);
+        void (GenericZ3Tests<Encoding>::*testFuncs[])() = {
+            &GenericZ3Tests<Encoding>::test0, &GenericZ3Tests<Encoding>::test1, &GenericZ3Tests<Encoding>::test2,
+            &GenericZ3Tests<Encoding>::test3, &GenericZ3Tests<Encoding>::test4, &GenericZ3Tests<Encoding>::test5,
+            &GenericZ3Tests<Encoding>::test6, &GenericZ3Tests<Encoding>::test7, &GenericZ3Tests<Encoding>::test8,
+            &GenericZ3Tests<Encoding>::test9, &GenericZ3Tests<Encoding>::test10};
+        for (auto testFunc : testFuncs)
+        {
+            (tests.*testFunc)();
+            tests.resetSolver();
+        }
+    }
+    double time = elapsedMs(start);
+    std::cout.rdbuf(coutBuf);
+    return time;
+}
+
+/*
+ * A generated program over numObjs heap objects:
+ *   p_i = malloc_i; *p_i = i;                      (for each object i)
+ *   x_j = *p_k + 1; *p_{k+1} = x_j;                (for each operation j, k = j % numObjs)
+ * The x_j are returned in xs.
+ */
+template<class Encoding>
+static void buildGenerated(GenericZ3Tests<Encoding> &tests, u32_t numObjs, u32_t numOps, std::vector<z3::expr> &xs)
+{
+    std::vector<z3::expr> ptrs;
+    for (u32_t i = 0; i < numObjs; i++)
+    {
+        z3::expr p = tests.getZ3Expr("p" + std::to_string(i));
+        tests.addToSolver(p == tests.getMemObjAddress("malloc" + std::to_string(i)));
+        tests.storeValue(p, tests.getZ3Expr(i));
+        ptrs.push_back(p);
+    }
+    for (u32_t j = 0; j < numOps; j++)
+    {
+        u32_t k = j % numObjs;
+        z3::expr x = tests.getZ3Expr("x" + std::to_string(j));
+        tests.addToSolver(x == tests.loadValue(ptrs[k]) + 1);
+        tests.storeValue(ptrs[(k + 1) % numObjs], x);
+        xs.push_back(x);
+    }
+}
+
+/// The generated program followed by assert(x_{numOps-1} > 0)
+template<class Encoding>
+static double runGenerated(u32_t numObjs, u32_t numOps, u32_t repeats,
+                           typename GenericZ3Mgr<Encoding>::MemModel memModel = GenericZ3Mgr<Encoding>::ArrayMem)
+{
+    Clock::time_point start = Clock::now();
+    for (u32_t r = 0; r < repeats; r++)
+    {
+        GenericZ3Tests<Encoding> tests;
+        tests.setMemModel(memModel);
+        std::vector<z3::expr> xs;
+        buildGenerated(tests, numObjs, numOps, xs);
+        tests.checkNegateAssert(xs.back() > tests.getZ3Expr(0));
+    }
+    return elapsedMs(start);
+}
+
+/// The generated program followed by assert(x_j > j / numObjs) for every j, checked one by one in the
+/// program's own manager (pool == nullptr) or in parallel by the pool; stats (if any) enables the interval
+/// pre-analysis and receives its counts
+template<class Encoding>
+static double runAsserts(u32_t numObjs, u32_t numOps, GenericZ3MgrPool<Encoding> *pool, IntervalStats *stats = nullptr)
+{
+    GenericZ3Tests<Encoding> tests;
+    tests.setIntervalAnalysis(stats != nullptr);
+    std::vector<z3::expr> xs;
+    buildGenerated(tests, numObjs, numOps, xs);
+    z3::expr_vector qs(tests.getCtx());
+    for (u32_t j = 0; j < xs.size(); j++)
+        qs.push_back(xs[j] > tests.getZ3Expr(j / numObjs));
+
+    Clock::time_point start = Clock::now();
+    u32_t holds = 0;
+    if (pool)
+    {
+        std::vector<std::future<AssertCheckResult>> results = pool->checkNegateAssertsAsync(tests, qs);
+        for (std::future<AssertCheckResult> &res : results)
+            holds += res.get().holds();
+    }
+    else
+    {
+        for (u32_t j = 0; j < qs.size(); j++)
+            holds += tests.checkNegateAssert(qs[j]);
+    }
+    double time = elapsedMs(start);
+    assert(holds == qs.size() && "the generated assertions should hold");
+    (void) holds;
+    if (stats)
+        *stats = tests.getIntervalStats();
+    return time;
+}
+
+template<class Encoding>
+static void runBench(u32_t numObjs, u32_t numOps, u32_t repeats)
+{
+    double testsTime = runTests<Encoding>(repeats, false);
+    double lightTime = runTests<Encoding>(repeats, true);
+    double generatedTime = runGenerated<Encoding>(numObjs, numOps, repeats);
+    std::cout << std::setw(10) << Encoding::name << std::setw(16) << testsTime << std::setw(16) << lightTime
+              << std::setw(16) << generatedTime << "\n";
+}
+
+/// Parse a positive count; return false if arg is not one
+static bool parseCount(const char *arg, u32_t &val)
+{
+    char *end;
+    unsigned long v = std::strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0' || arg[0] == '-' || v == 0 || v > 0xffffffffUL)
+        return false;
+    val = v;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    u32_t numObjs = 16, numOps = 256, repeats = 5;
+    u32_t *counts[] = {&numObjs, &numOps, &repeats};
+    if (argc > 4)
+    {
+        std::cerr << "Usage: z3bench [numObjs] [numOps] [repeats]\n";
+        return 1;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (!parseCount(argv[i], *counts[i - 1]))
+        {
+            std::cerr << "z3bench: '" << argv[i] << "' is not a positive count\n"
+                      << "Usage: z3bench [numObjs] [numOps] [repeats]\n";
+            return 1;
+        }
+    }
+
+    std::cout.flags(std::ios::left);
+    const char *config = std::getenv("Z3MGR_SOLVER_CONFIG");
+    std::cout << "objects: " << numObjs << ", operations: " << numOps << ", repeats: " << repeats
+              << ", solver config: " << (config ? config : "default") << "\n";
+    std::cout << std::setw(10) << "encoding" << std::setw(16) << "tests (ms)" << std::setw(16) << "light reset"
+              << std::setw(16) << "generated (ms)" << "\n";
+    runBench<IntEncoding>(numObjs, numOps, repeats);
+    runBench<BV32Encoding>(numObjs, numOps, repeats);
+    runBench<BV64Encoding>(numObjs, numOps, repeats);
+
+    typedef GenericZ3Mgr<DefaultEncoding> Mgr;
+    std::cout << "\ngenerated (" << DefaultEncoding::name << "): ArrayMem "
+              << runGenerated<DefaultEncoding>(numObjs, numOps, repeats, Mgr::ArrayMem) << " ms, RegionMem "
+              << runGenerated<DefaultEncoding>(numObjs, numOps, repeats, Mgr::RegionMem) << " ms, FlatMem "
+              << runGenerated<DefaultEncoding>(numObjs, numOps, repeats, Mgr::FlatMem) << " ms\n";
+
+    GenericZ3MgrPool<DefaultEncoding> pool;
+    std::cout << "\n" << numOps << " assertions (" << DefaultEncoding::name << "): sequential "
+              << runAsserts<DefaultEncoding>(numObjs, numOps, nullptr) << " ms, pool of " << pool.getNumThreads()
+              << " threads " << runAsserts<DefaultEncoding>(numObjs, numOps, &pool) << " ms";
+    IntervalStats stats;
+    double intervalTime = runAsserts<DefaultEncoding>(numObjs, numOps, nullptr, &stats);
+    std::cout << ", intervals first " << intervalTime << " ms (" << stats.proved << " proved, " << stats.refuted
+              << " refuted, " << stats.undecided << " undecided)\n";
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * Z3ConstantPropagation.cpp
+ * Constant propagation over the constraints of GenericZ3Mgr: definitions (var == numeral) become substitutions
+ * folded into the later constraints and queries instead of solver constraints.
+ */
+
+#include "Z3ConstantPropagation.h"
+#include <cassert>
+
+using namespace SVF;
+
+void Z3ConstantPropagation::pop(uint32_t n)
+{
+    assert(substScopes.size() >= n && "pop more scopes than pushed?");
+    uint32_t num = substScopes[substScopes.size() - n];
+    substSrc.resize(num);
+    substDst.resize(num);
+    substScopes.resize(substScopes.size() - n);
+}
+
+/// The symbols of popped constraints are kept until the reset: a definition of one of them is then sent to the
+/// solver although it may not be needed, which is harmless
+void Z3ConstantPropagation::reset()
+{
+    substSrc.resize(0);
+    substDst.resize(0);
+    substScopes.clear();
+    solverSyms.clear();
+}
+
+bool Z3ConstantPropagation::getDefinition(const z3::expr &e, z3::expr &var, z3::expr &val)
+{
+    if (!e.is_app() || e.decl().decl_kind() != Z3_OP_EQ)
+        return false;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        z3::expr lhs = e.arg(i);
+        z3::expr rhs = e.arg(1 - i);
+        if (lhs.is_const() && !lhs.is_numeral() && lhs.decl().decl_kind() == Z3_OP_UNINTERPRETED && rhs.is_numeral())
+        {
+            var = lhs;
+            val = rhs;
+            return true;
+        }
+    }
+    return false;
+}
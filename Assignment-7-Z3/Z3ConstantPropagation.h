@@ -0,0 +1,121 @@
+/**
+ * Z3ConstantPropagation.h
+ * Constant propagation over the constraints of GenericZ3Mgr: definitions (var == numeral) become substitutions
+ * folded into the later constraints and queries instead of solver constraints.
+ */
+
+#ifndef ANSWERS_DEV_Z3CONSTANTPROPAGATION_H
+#define ANSWERS_DEV_Z3CONSTANTPROPAGATION_H
+
+#include "z3++.h"
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+namespace SVF
+{
+
+/// The substitutions (var -> numeral) of the definitions found so far, with scopes popped together with the
+/// solver's, and the symbols of the constraints sent to the solver, which decide whether a definition must be
+/// sent as well. Symbols are keys computed by the manager (see GenericZ3Mgr::collectSymbols).
+class Z3ConstantPropagation
+{
+public:
+    explicit Z3ConstantPropagation(z3::context &ctx) : enabled(false), substSrc(ctx), substDst(ctx)
+    {}
+
+    inline void setEnabled(bool enable)
+    {
+        enabled = enable;
+    }
+
+    inline bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /// Substitute the propagated constants into e and fold it
+    inline z3::expr propagate(z3::expr e) const
+    {
+        if (substSrc.empty())
+            return e.simplify();
+        return e.substitute(substSrc, substDst).simplify();
+    }
+
+    /// Return the folded query if substitutions are known, otherwise e itself
+    inline z3::expr fold(const z3::expr &e) const
+    {
+        return substSrc.empty() ? e : propagate(e);
+    }
+
+    /// Fold e with the known constants; a definitional equality (var == numeral) extends the substitution map.
+    /// Return false if e needs not be sent to the solver: it is folded to true, or it defines a variable that
+    /// does not occur in the constraints already in the solver (so the solver never needs its value).
+    /// collect(e, syms) appends the symbols of e to syms.
+    template<class Collect>
+    bool addConstraint(z3::expr &e, Collect collect)
+    {
+        e = propagate(e);
+        if (e.is_true())
+            return false;
+        std::vector<uint64_t> syms;
+        z3::expr var(e.ctx());
+        z3::expr val(e.ctx());
+        if (getDefinition(e, var, val))
+        {
+            substSrc.push_back(var);
+            substDst.push_back(val);
+            collect(var, syms);
+            return solverSyms.count(syms[0]) != 0;
+        }
+        collect(e, syms);
+        solverSyms.insert(syms.begin(), syms.end());
+        return true;
+    }
+
+    /// The substitutions, in the order they were found
+    ///@{
+    inline uint32_t getNumSubstitutions() const
+    {
+        return substSrc.size();
+    }
+    inline z3::expr getVar(uint32_t i) const
+    {
+        return substSrc[i];
+    }
+    inline z3::expr getValue(uint32_t i) const
+    {
+        return substDst[i];
+    }
+    /// Return the number of substitutions when scope k was pushed (all of them if k is the number of scopes)
+    inline uint32_t getScopeStart(uint32_t k) const
+    {
+        return k < substScopes.size() ? substScopes[k] : substSrc.size();
+    }
+    ///@}
+
+    /// Scopes, popped together with the solver's
+    ///@{
+    inline void push()
+    {
+        substScopes.push_back(substSrc.size());
+    }
+    void pop(uint32_t n);
+    /// Drop every substitution and scope, and forget the symbols sent to the solver
+    void reset();
+    ///@}
+
+private:
+    /// Return true if e is (var == numeral) or (numeral == var)
+    static bool getDefinition(const z3::expr &e, z3::expr &var, z3::expr &val);
+
+    bool enabled;                           /// whether constant propagation is enabled
+    z3::expr_vector substSrc;               /// propagated variables
+    z3::expr_vector substDst;               /// substDst[i]: the constant of substSrc[i]
+    std::vector<uint32_t> substScopes;      /// number of substitutions when each scope was pushed
+    std::unordered_set<uint64_t> solverSyms;    /// symbols of the constraints sent to the solver
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3CONSTANTPROPAGATION_H
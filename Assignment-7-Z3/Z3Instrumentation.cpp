@@ -0,0 +1,186 @@
+/**
+ * Z3Instrumentation.cpp
+ * Per-operation timing, Z3 statistics and expression sizes of GenericZ3Mgr sessions.
+ */
+
+#include "Z3Instrumentation.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+using namespace SVF;
+
+const char *Z3Event::getKindName(Kind k)
+{
+    switch (k)
+    {
+    case Check:
+        return "check";
+    case GetModel:
+        return "get_model";
+    case Store:
+        return "storeValue";
+    case Load:
+        return "loadValue";
+    }
+    return "unknown";
+}
+
+/// A function-local static, so the events are written when static objects are destroyed at exit
+Z3Instrumentation &Z3Instrumentation::getInstance()
+{
+    static Z3Instrumentation instance;
+    return instance;
+}
+
+Z3Instrumentation::Z3Instrumentation() : enabled(false), maxEvents(DefaultMaxEvents), summaries(), dropped(0)
+{
+    if (const char *file = std::getenv("Z3MGR_STATS"))
+        setOutput(file);
+}
+
+Z3Instrumentation::~Z3Instrumentation()
+{
+    if (outFile.empty())
+        return;
+    std::ofstream out(outFile, std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "cannot write Z3 statistics to " << outFile << "\n";
+        return;
+    }
+    bool csv = outFile.size() >= 4 && outFile.compare(outFile.size() - 4, 4, ".csv") == 0;
+    if (csv)
+        exportCSV(out);
+    else
+        exportJSON(out);
+}
+
+void Z3Instrumentation::setOutput(const std::string &file)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    outFile = file;
+    enabled = true;
+}
+
+void Z3Instrumentation::record(const Z3Event &event)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    summaries[event.kind].count++;
+    summaries[event.kind].totalMs += event.timeMs;
+    if (events.size() < maxEvents)
+        events.push_back(event);
+    else
+        dropped++;
+}
+
+void Z3Instrumentation::setMaxEvents(size_t max)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    maxEvents = max;
+}
+
+size_t Z3Instrumentation::getMaxEvents()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxEvents;
+}
+
+void Z3Instrumentation::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+    for (Summary &summary : summaries)
+        summary = Summary();
+    dropped = 0;
+}
+
+void Z3Instrumentation::fillStatistics(Z3Event &event, const z3::solver &s)
+{
+    z3::stats st = s.statistics();
+    for (unsigned i = 0; i < st.size(); i++)
+    {
+        std::string key = st.key(i);
+        double val = st.is_uint(i) ? st.uint_value(i) : st.double_value(i);
+        if (key == "conflicts")
+            event.conflicts = val;
+        else if (key == "decisions")
+            event.decisions = val;
+        else if (key == "memory")
+            event.memoryMB = val;
+    }
+}
+
+unsigned Z3Instrumentation::getDAGSize(const z3::expr &e)
+{
+    std::unordered_set<unsigned> visited;
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty())
+    {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!visited.insert(cur.id()).second || !cur.is_app())
+            continue;
+        for (unsigned i = 0; i < cur.num_args(); i++)
+            todo.push_back(cur.arg(i));
+    }
+    return visited.size();
+}
+
+/// Walk down to the first store of known depth, then memoize the stores above it
+unsigned Z3StoreDepths::get(const z3::expr &mem)
+{
+    std::vector<z3::expr> chain;
+    unsigned depth = 0;
+    z3::expr cur = mem;
+    while (cur.is_app() && cur.decl().decl_kind() == Z3_OP_STORE)
+    {
+        auto it = depths.find(cur.id());
+        if (it != depths.end())
+        {
+            depth = it->second.second;
+            break;
+        }
+        chain.push_back(cur);
+        cur = cur.arg(0);
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        depths.emplace(it->id(), std::make_pair(*it, ++depth));
+    return depth;
+}
+
+/// {"summary": {kind: {"count", "totalMs"}}, "dropped": n, "events": [{...}, ...]}
+void Z3Instrumentation::exportJSON(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    os << "{\n  \"summary\": {";
+    for (unsigned k = 0; k < NumKinds; k++)
+    {
+        os << (k ? ", " : "") << "\"" << Z3Event::getKindName((Z3Event::Kind) k) << "\": {\"count\": "
+           << summaries[k].count << ", \"totalMs\": " << summaries[k].totalMs << "}";
+    }
+    os << "},\n  \"dropped\": " << dropped << ",\n  \"events\": [";
+    for (unsigned i = 0; i < events.size(); i++)
+    {
+        const Z3Event &e = events[i];
+        os << (i ? ",\n" : "\n") << "    {\"kind\": \"" << Z3Event::getKindName(e.kind) << "\", \"timeMs\": " << e.timeMs
+           << ", \"result\": \"" << e.result << "\", \"exprSize\": " << e.exprSize << ", \"numAssertions\": "
+           << e.numAssertions << ", \"memDepth\": " << e.memDepth << ", \"conflicts\": " << e.conflicts
+           << ", \"decisions\": " << e.decisions << ", \"memoryMB\": " << e.memoryMB << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+void Z3Instrumentation::exportCSV(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    os << "kind,timeMs,result,exprSize,numAssertions,memDepth,conflicts,decisions,memoryMB\n";
+    for (const Z3Event &e : events)
+    {
+        os << Z3Event::getKindName(e.kind) << "," << e.timeMs << "," << e.result << "," << e.exprSize << ","
+           << e.numAssertions << "," << e.memDepth << "," << e.conflicts << "," << e.decisions << "," << e.memoryMB
+           << "\n";
+    }
+}
@@ -0,0 +1,141 @@
+/**
+ * Z3Instrumentation.h
+ * Per-operation timing, Z3 statistics and expression sizes of GenericZ3Mgr sessions.
+ */
+
+#ifndef ANSWERS_DEV_Z3INSTRUMENTATION_H
+#define ANSWERS_DEV_Z3INSTRUMENTATION_H
+
+#include "z3++.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SVF
+{
+
+/// One instrumented operation of GenericZ3Mgr
+struct Z3Event
+{
+    enum Kind
+    {
+        Check,      ///< a solver check (for a model, or of one assertion)
+        GetModel,   ///< a model extraction
+        Store,      ///< storeValue (including the evaluation of the address)
+        Load        ///< loadValue (including the evaluation of the address)
+    };
+
+    Kind kind;
+    double timeMs;          /// wall time
+    std::string result;     /// sat/unsat/unknown (Check)
+    unsigned exprSize;      /// DAG size of the checked assertion (Check), or of the address and value (Store/Load)
+    unsigned numAssertions; /// number of assertions in the solver (Check/GetModel)
+    unsigned memDepth;      /// number of stores in the memory written/read (Store/Load)
+    uint64_t conflicts;     /// Z3 statistics after the check (Check); cumulative for incremental solvers
+    uint64_t decisions;
+    double memoryMB;
+
+    Z3Event(Kind k, double t)
+            : kind(k), timeMs(t), exprSize(0), numAssertions(0), memDepth(0), conflicts(0), decisions(0), memoryMB(0)
+    {}
+
+    static const char *getKindName(Kind k);
+};
+
+/// Number of nested stores of array expressions, memoized so that each store of a chain is walked only once.
+/// The memoized arrays are kept alive, so their AST ids are not reused for other expressions.
+class Z3StoreDepths
+{
+public:
+    unsigned get(const z3::expr &mem);
+
+    inline void clear()
+    {
+        depths.clear();
+    }
+
+private:
+    std::unordered_map<unsigned, std::pair<z3::expr, unsigned>> depths;   /// AST id -> (store, depth)
+};
+
+/// Process-wide collector of Z3Events (thread-safe).
+/// It is enabled by the environment variable Z3MGR_STATS, whose value is the output file written at
+/// process exit: CSV if the file name ends with ".csv", JSON otherwise.
+/// The summary per kind counts every event, but only the first getMaxEvents() events are kept.
+class Z3Instrumentation
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static Z3Instrumentation &getInstance();
+
+    static const size_t DefaultMaxEvents = 1 << 20;
+
+    /// Whether new managers record their operations (GenericZ3Mgr::setInstrumentation overrides it)
+    inline bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /// Set the file written at exit (empty: nothing is written) and enable the instrumentation
+    void setOutput(const std::string &file);
+
+    void record(const Z3Event &event);
+
+    /// The number of events kept (the later ones only count in the summary)
+    ///@{
+    void setMaxEvents(size_t max);
+    size_t getMaxEvents();
+    ///@}
+
+    /// Drop all events and the summary
+    void clear();
+
+    /// Fill the Z3 statistics of a check event from the solver
+    static void fillStatistics(Z3Event &event, const z3::solver &s);
+
+    /// Number of distinct sub-expressions of e
+    static unsigned getDAGSize(const z3::expr &e);
+
+    static inline double elapsedMs(Clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        return elapsed.count();
+    }
+
+    /// Write all events, and a summary per kind
+    ///@{
+    void exportJSON(std::ostream &os);
+    void exportCSV(std::ostream &os);
+    ///@}
+
+    /// Write the output file (if any)
+    ~Z3Instrumentation();
+
+private:
+    Z3Instrumentation();
+
+    /// Number and total time of the events of one kind
+    struct Summary
+    {
+        uint64_t count;
+        double totalMs;
+    };
+    static const unsigned NumKinds = 4;
+
+    std::atomic<bool> enabled;
+    std::string outFile;
+    std::mutex mutex;
+    std::vector<Z3Event> events;
+    size_t maxEvents;
+    Summary summaries[NumKinds];
+    uint64_t dropped;   /// events beyond maxEvents
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3INSTRUMENTATION_H
@@ -0,0 +1,401 @@
+/**
+ * Z3IntervalDomain.cpp
+ * An interval/constant abstract domain over the constraints of GenericZ3Mgr, used to decide assertions
+ * without calling Z3.
+ */
+
+#include "Z3IntervalDomain.h"
+
+using namespace SVF;
+
+static inline bool isSymbol(const z3::expr &e)
+{
+    return e.is_const() && !e.is_numeral() && e.decl().decl_kind() == Z3_OP_UNINTERPRETED;
+}
+
+Interval Z3IntervalDomain::getRange(const z3::sort &s)
+{
+    if (s.is_bool())
+        return Interval(0, 1);
+    if (s.is_bv())
+    {
+        Interval::Bound half = (Interval::Bound) 1 << (s.bv_size() - 1);
+        return Interval(-half, half - 1);
+    }
+    return Interval::top();
+}
+
+Interval Z3IntervalDomain::normalize(Interval::Bound lo, Interval::Bound hi, const z3::sort &s)
+{
+    if (s.is_bv())
+    {
+        Interval range = getRange(s);
+        if (lo < range.lo || hi > range.hi)
+            return range;
+        return Interval(lo, hi);
+    }
+    if (lo < INT64_MIN)
+        lo = Interval::NegInf;
+    else if (lo > INT64_MAX)
+        lo = INT64_MAX;
+    if (hi > INT64_MAX)
+        hi = Interval::PosInf;
+    else if (hi < INT64_MIN)
+        hi = INT64_MIN;
+    return Interval(lo, hi);
+}
+
+/// Bit-vector numerals are unsigned, so they are sign-extended as in BVEncoding
+bool Z3IntervalDomain::getNumeral(const z3::expr &e, int64_t &val)
+{
+    if (e.is_int())
+        return e.is_numeral_i64(val);
+    uint64_t uval;
+    if (!e.is_bv() || !e.is_numeral_u64(uval))
+        return false;
+    uint32_t width = e.get_sort().bv_size();
+    if (width < 64 && ((uval >> (width - 1)) & 1))
+        uval |= ~(uint64_t) 0 << width;
+    val = (int64_t) uval;
+    return true;
+}
+
+bool Z3IntervalDomain::lookup(const z3::expr &var, Interval &val) const
+{
+    auto it = vars.find(var.id());
+    if (it == vars.end())
+        return false;
+    val = it->second.val;
+    return true;
+}
+
+Interval Z3IntervalDomain::eval(const z3::expr &e)
+{
+    Memo memo;
+    return eval(e, memo);
+}
+
+Interval Z3IntervalDomain::eval(const z3::expr &e, Memo &memo)
+{
+    auto it = memo.find(e.id());
+    if (it != memo.end())
+        return it->second;
+    Interval val = e.is_app() ? evalApp(e, memo) : getRange(e.get_sort());
+    memo.emplace(e.id(), val);
+    return val;
+}
+
+Interval Z3IntervalDomain::evalApp(const z3::expr &e, Memo &memo)
+{
+    int64_t num;
+    if (getNumeral(e, num))
+        return Interval(num, num);
+    z3::sort sort = e.get_sort();
+    if (isSymbol(e))
+    {
+        Interval val = getRange(sort);
+        lookup(e, val);
+        return val;
+    }
+    Z3_decl_kind kind = e.decl().decl_kind();
+    uint32_t n = e.num_args();
+    switch (kind)
+    {
+    case Z3_OP_TRUE:
+        return Interval(1, 1);
+    case Z3_OP_FALSE:
+        return Interval(0, 0);
+    case Z3_OP_ADD:
+    case Z3_OP_BADD:
+    case Z3_OP_SUB:
+    case Z3_OP_BSUB:
+    {
+        bool sub = kind == Z3_OP_SUB || kind == Z3_OP_BSUB;
+        Interval acc = eval(e.arg(0), memo);
+        for (uint32_t i = 1; i < n; i++)
+        {
+            Interval arg = eval(e.arg(i), memo);
+            acc.lo += sub ? -arg.hi : arg.lo;
+            acc.hi += sub ? -arg.lo : arg.hi;
+            acc = normalize(acc.lo, acc.hi, sort);
+        }
+        return acc;
+    }
+    case Z3_OP_UMINUS:
+    case Z3_OP_BNEG:
+    {
+        Interval arg = eval(e.arg(0), memo);
+        return normalize(-arg.hi, -arg.lo, sort);
+    }
+    case Z3_OP_MUL:
+    case Z3_OP_BMUL:
+    {
+        Interval acc = eval(e.arg(0), memo);
+        for (uint32_t i = 1; i < n; i++)
+        {
+            Interval arg = eval(e.arg(i), memo);
+            if ((acc.lo == 0 && acc.hi == 0) || (arg.lo == 0 && arg.hi == 0))
+            {
+                acc = Interval(0, 0);
+                continue;
+            }
+            if (acc.lo == Interval::NegInf || acc.hi == Interval::PosInf || arg.lo == Interval::NegInf ||
+                arg.hi == Interval::PosInf)
+                return getRange(sort);
+            Interval::Bound p[] = {acc.lo * arg.lo, acc.lo * arg.hi, acc.hi * arg.lo, acc.hi * arg.hi};
+            acc = normalize(*std::min_element(p, p + 4), *std::max_element(p, p + 4), sort);
+        }
+        return acc;
+    }
+    case Z3_OP_ITE:
+    {
+        Interval cond = eval(e.arg(0), memo);
+        if (cond.lo == 1)
+            return eval(e.arg(1), memo);
+        if (cond.hi == 0)
+            return eval(e.arg(2), memo);
+        return eval(e.arg(1), memo).join(eval(e.arg(2), memo));
+    }
+    case Z3_OP_EQ:
+    case Z3_OP_DISTINCT:
+    case Z3_OP_LE:
+    case Z3_OP_LT:
+    case Z3_OP_GE:
+    case Z3_OP_GT:
+    case Z3_OP_SLEQ:
+    case Z3_OP_SLT:
+    case Z3_OP_SGEQ:
+    case Z3_OP_SGT:
+    {
+        if (n != 2)
+            return Interval(0, 1);
+        return evalCompare(kind, eval(e.arg(0), memo), eval(e.arg(1), memo));
+    }
+    case Z3_OP_NOT:
+    {
+        Interval arg = eval(e.arg(0), memo);
+        return Interval(1 - arg.hi, 1 - arg.lo);
+    }
+    case Z3_OP_AND:
+    case Z3_OP_OR:
+    {
+        // and: true if all are true, false if any is false (dually for or)
+        int64_t absorbing = kind == Z3_OP_AND ? 0 : 1;
+        bool allNeutral = true;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            Interval arg = eval(e.arg(i), memo);
+            if (arg.lo == absorbing && arg.hi == absorbing)
+                return Interval(absorbing, absorbing);
+            allNeutral &= arg.lo == 1 - absorbing && arg.hi == 1 - absorbing;
+        }
+        return allNeutral ? Interval(1 - absorbing, 1 - absorbing) : Interval(0, 1);
+    }
+    case Z3_OP_IMPLIES:
+    {
+        Interval lhs = eval(e.arg(0), memo);
+        Interval rhs = eval(e.arg(1), memo);
+        if (lhs.hi == 0 || rhs.lo == 1)
+            return Interval(1, 1);
+        if (lhs.lo == 1 && rhs.hi == 0)
+            return Interval(0, 0);
+        return Interval(0, 1);
+    }
+    case Z3_OP_SELECT:
+        return evalSelect(e, memo);
+    default:
+        return getRange(sort);
+    }
+}
+
+Interval Z3IntervalDomain::evalCompare(Z3_decl_kind kind, const Interval &a, const Interval &b) const
+{
+    const Interval T(1, 1), F(0, 0), U(0, 1);
+    switch (kind)
+    {
+    case Z3_OP_EQ:
+        return a.isPoint() && b.isPoint() && a.lo == b.lo ? T : (a.hi < b.lo || b.hi < a.lo) ? F : U;
+    case Z3_OP_DISTINCT:
+        return a.isPoint() && b.isPoint() && a.lo == b.lo ? F : (a.hi < b.lo || b.hi < a.lo) ? T : U;
+    case Z3_OP_LE:
+    case Z3_OP_SLEQ:
+        return a.hi <= b.lo ? T : a.lo > b.hi ? F : U;
+    case Z3_OP_LT:
+    case Z3_OP_SLT:
+        return a.hi < b.lo ? T : a.lo >= b.hi ? F : U;
+    case Z3_OP_GE:
+    case Z3_OP_SGEQ:
+        return evalCompare(Z3_OP_LE, b, a);
+    case Z3_OP_GT:
+    case Z3_OP_SGT:
+        return evalCompare(Z3_OP_LT, b, a);
+    default:
+        return U;
+    }
+}
+
+/// select(store(...store(m, a1, v1)..., an, vn), a): the value of the latest store whose address equals a, if
+/// the addresses of the stores after it are all known to differ from a
+Interval Z3IntervalDomain::evalSelect(const z3::expr &e, Memo &memo)
+{
+    Interval addr = eval(e.arg(1), memo);
+    z3::expr mem = e.arg(0);
+    while (addr.isPoint() && mem.is_app() && mem.decl().decl_kind() == Z3_OP_STORE)
+    {
+        Interval storeAddr = eval(mem.arg(1), memo);
+        if (storeAddr.isPoint() && storeAddr.lo == addr.lo)
+            return eval(mem.arg(2), memo);
+        if (storeAddr.lo <= addr.lo && addr.lo <= storeAddr.hi)
+            break;
+        mem = mem.arg(0);
+    }
+    return getRange(e.get_sort());
+}
+
+void Z3IntervalDomain::narrow(const z3::expr &var, const Interval &val)
+{
+    Interval cur = getRange(var.get_sort());
+    bool existed = lookup(var, cur);
+    Interval next = cur.meet(val);
+    if (next.lo == cur.lo && next.hi == cur.hi)
+        return;
+    trail.push_back(TrailEntry{var.id(), existed, cur});
+    if (existed)
+        vars.at(var.id()).val = next;
+    else
+        vars.emplace(var.id(), VarEntry{var, next});
+    if (next.isEmpty())
+        infeasible = true;
+}
+
+/// x <= o narrows x to [min, o.hi], x < o to [min, o.hi - 1] (dually for >= and >); o <= x is x >= o.
+/// The bounds are 128-bit, so o.hi - 1 and o.lo + 1 cannot overflow, and a real INT64_MIN/INT64_MAX bound is finite
+void Z3IntervalDomain::narrowCompare(const z3::expr &c)
+{
+    Z3_decl_kind kind = c.decl().decl_kind();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        z3::expr var = c.arg(i);
+        if (!isSymbol(var))
+            continue;
+        Interval other = eval(c.arg(1 - i));
+        bool upper = kind == Z3_OP_LE || kind == Z3_OP_SLEQ || kind == Z3_OP_LT || kind == Z3_OP_SLT;
+        bool strict = kind == Z3_OP_LT || kind == Z3_OP_SLT || kind == Z3_OP_GT || kind == Z3_OP_SGT;
+        if (i == 1)
+            upper = !upper;
+        Interval range = getRange(var.get_sort());
+        if (upper)
+            narrow(var, Interval(range.lo, strict && other.hi != Interval::PosInf ? other.hi - 1 : other.hi));
+        else
+            narrow(var, Interval(strict && other.lo != Interval::NegInf ? other.lo + 1 : other.lo, range.hi));
+    }
+}
+
+/// A constraint that is already true is implied; (x == e) with a new variable x and a constant e defines x.
+/// Any other constraint makes the domain inexact, and narrows the variables it bounds
+void Z3IntervalDomain::assume(const z3::expr &c)
+{
+    if (infeasible)
+        return;
+    Interval val = eval(c);
+    if (val.hi == 0 || val.isEmpty())
+    {
+        infeasible = true;
+        return;
+    }
+    if (val.lo == 1 || !c.is_app())
+        return;
+    Z3_decl_kind kind = c.decl().decl_kind();
+    if (kind == Z3_OP_EQ && c.num_args() == 2)
+    {
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            z3::expr var = c.arg(i);
+            if (!isSymbol(var))
+                continue;
+            Interval other = eval(c.arg(1 - i));
+            if (other.isPoint() && !vars.count(var.id()))
+            {
+                narrow(var, other);
+                return;
+            }
+        }
+    }
+    exact = false;
+    switch (kind)
+    {
+    case Z3_OP_AND:
+        for (uint32_t i = 0; i < c.num_args(); i++)
+            assume(c.arg(i));
+        break;
+    case Z3_OP_EQ:
+        for (uint32_t i = 0; i < 2 && c.num_args() == 2; i++)
+        {
+            if (isSymbol(c.arg(i)))
+                narrow(c.arg(i), eval(c.arg(1 - i)));
+        }
+        break;
+    case Z3_OP_LE:
+    case Z3_OP_LT:
+    case Z3_OP_GE:
+    case Z3_OP_GT:
+    case Z3_OP_SLEQ:
+    case Z3_OP_SLT:
+    case Z3_OP_SGEQ:
+    case Z3_OP_SGT:
+        narrowCompare(c);
+        break;
+    case Z3_OP_NOT:
+        if (isSymbol(c.arg(0)))
+            narrow(c.arg(0), Interval(0, 0));
+        break;
+    default:
+        if (isSymbol(c))
+            narrow(c, Interval(1, 1));
+        break;
+    }
+}
+
+Z3IntervalDomain::Verdict Z3IntervalDomain::check(const z3::expr &q)
+{
+    if (infeasible)
+        return Holds;
+    Interval val = eval(q);
+    if (val.lo == 1)
+        return Holds;
+    if (val.hi == 0)
+        return Fails;
+    return Unknown;
+}
+
+void Z3IntervalDomain::push()
+{
+    scopes.push_back(Scope{(uint32_t) trail.size(), exact, infeasible});
+}
+
+void Z3IntervalDomain::pop(uint32_t n)
+{
+    assert(scopes.size() >= n && "pop more scopes than pushed?");
+    const Scope &scope = scopes[scopes.size() - n];
+    while (trail.size() > scope.trailSize)
+    {
+        const TrailEntry &entry = trail.back();
+        if (entry.existed)
+            vars.at(entry.id).val = entry.old;
+        else
+            vars.erase(entry.id);
+        trail.pop_back();
+    }
+    exact = scope.exact;
+    infeasible = scope.infeasible;
+    scopes.resize(scopes.size() - n);
+}
+
+void Z3IntervalDomain::reset()
+{
+    vars.clear();
+    trail.clear();
+    scopes.clear();
+    exact = true;
+    infeasible = false;
+}
@@ -0,0 +1,161 @@
+/**
+ * Z3IntervalDomain.h
+ * An interval/constant abstract domain over the constraints of GenericZ3Mgr, used to decide assertions
+ * without calling Z3.
+ */
+
+#ifndef ANSWERS_DEV_Z3INTERVALDOMAIN_H
+#define ANSWERS_DEV_Z3INTERVALDOMAIN_H
+
+#include "z3++.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace SVF
+{
+
+/// A range [lo, hi] of signed values. The bounds are 128-bit with explicit infinities (NegInf and PosInf), so that
+/// every int64_t value, including INT64_MIN and INT64_MAX, is a finite bound.
+/// Booleans are [0, 0] (false), [1, 1] (true) or [0, 1] (unknown).
+struct Interval
+{
+    typedef __int128 Bound;
+
+    /// Infinite bounds, far beyond any finite bound, and such that sums of many of them do not overflow
+    static constexpr Bound PosInf = (Bound) 1 << 100;
+    static constexpr Bound NegInf = -PosInf;
+
+    Bound lo;
+    Bound hi;
+
+    Interval(Bound l, Bound h) : lo(l), hi(h)
+    {}
+
+    static inline Interval top()
+    {
+        return Interval(NegInf, PosInf);
+    }
+
+    inline bool isEmpty() const
+    {
+        return lo > hi;
+    }
+
+    inline bool isPoint() const
+    {
+        return lo == hi && lo != NegInf && lo != PosInf;
+    }
+
+    inline Interval meet(const Interval &other) const
+    {
+        return Interval(std::max(lo, other.lo), std::min(hi, other.hi));
+    }
+
+    inline Interval join(const Interval &other) const
+    {
+        return Interval(std::min(lo, other.lo), std::max(hi, other.hi));
+    }
+};
+
+/// Interval values of the variables (uninterpreted constants) implied by a set of constraints, with scopes.
+/// Constraints are assumed one at a time: conjunctions, equalities and comparisons between a variable and an
+/// expression narrow the variable, other constraints are only used to detect that they are false. Expressions are
+/// evaluated bottom-up over numerals, variables, +, -, *, ite and comparisons of Int or signed bit-vector sorts;
+/// a select of a store chain with concrete addresses is resolved to the stored value. Every other operator (and a
+/// bit-vector result that may wrap around) evaluates to the whole range of its sort, so the domain over-approximates
+/// the solutions of the constraints.
+class Z3IntervalDomain
+{
+public:
+    enum Verdict
+    {
+        Unknown,    ///< the assertion may or may not hold
+        Holds,      ///< the assertion holds in every solution of the constraints
+        Fails       ///< the assertion is false in every solution of the constraints
+    };
+
+    Z3IntervalDomain() : exact(true), infeasible(false)
+    {}
+
+    /// Narrow the variables with constraint c
+    void assume(const z3::expr &c);
+
+    /// Decide assertion q under the constraints assumed so far
+    Verdict check(const z3::expr &q);
+
+    /// Evaluate e (a Boolean, an Int or a bit-vector expression) under the constraints assumed so far
+    Interval eval(const z3::expr &e);
+
+    /// Whether the constraints are known to be satisfiable: so far, each of them either defined a new variable
+    /// as a constant, or was implied by the previous ones
+    inline bool isExact() const
+    {
+        return exact && !infeasible;
+    }
+
+    /// Whether the constraints are known to be unsatisfiable
+    inline bool isInfeasible() const
+    {
+        return infeasible;
+    }
+
+    /// Scopes, popped together with the solver's
+    ///@{
+    void push();
+    void pop(uint32_t n);
+    void reset();
+    ///@}
+
+private:
+    /// A variable and its interval (the expression keeps the AST id of the key alive)
+    struct VarEntry
+    {
+        z3::expr var;
+        Interval val;
+    };
+    /// The previous interval of a variable, restored when its scope is popped
+    struct TrailEntry
+    {
+        unsigned id;
+        bool existed;
+        Interval old;
+    };
+    /// Scope state saved by push
+    struct Scope
+    {
+        uint32_t trailSize;
+        bool exact;
+        bool infeasible;
+    };
+    typedef std::unordered_map<unsigned, Interval> Memo;
+
+    Interval eval(const z3::expr &e, Memo &memo);
+    Interval evalApp(const z3::expr &e, Memo &memo);
+    Interval evalCompare(Z3_decl_kind kind, const Interval &a, const Interval &b) const;
+    Interval evalSelect(const z3::expr &e, Memo &memo);
+    /// Narrow var to val (the meet with its current interval)
+    void narrow(const z3::expr &var, const Interval &val);
+    /// Narrow the variable operand(s) of a comparison c
+    void narrowCompare(const z3::expr &c);
+    bool lookup(const z3::expr &var, Interval &val) const;
+
+    /// The range of the values of sort s
+    static Interval getRange(const z3::sort &s);
+    /// Clamp an exact result to sort s: beyond the range of a bit-vector it may wrap around, so it is the whole
+    /// range; for Int, a bound beyond int64_t is widened (to infinity, or back to the int64_t range), so that the
+    /// finite bounds stay near int64_t and products of two of them cannot overflow
+    static Interval normalize(Interval::Bound lo, Interval::Bound hi, const z3::sort &s);
+    static bool getNumeral(const z3::expr &e, int64_t &val);
+
+    std::unordered_map<unsigned, VarEntry> vars;
+    std::vector<TrailEntry> trail;
+    std::vector<Scope> scopes;
+    bool exact;         /// whether every constraint so far defined a new variable as a constant or was implied
+    bool infeasible;    /// whether some constraint was found false
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3INTERVALDOMAIN_H
@@ -0,0 +1,161 @@
+/**
+ * Z3Memory.cpp
+ * The memory of GenericZ3Mgr: loc2ValMap and the state of the shadow, region and flat memory models.
+ */
+
+#include "Z3Mgr.h"
+#include <algorithm>
+
+using namespace SVF;
+
+template<class Encoding>
+void Z3Memory<Encoding>::reset()
+{
+    loc2ValMap = initLoc2ValMap;
+    resetShadow();
+    resetRegions();
+    memObj2Base.clear();
+    multiCellObjs.clear();
+}
+
+template<class Encoding>
+bool Z3Memory<Encoding>::loadShadow(u32_t id, const z3::expr &addr, z3::expr &val) const
+{
+    if (!shadowValid)
+        return false;
+    if (shadowVals.has(id))
+        val = shadowVals.get(id);
+    else
+        val = z3::select(initLoc2ValMap, addr);     // never written: read the initial memory directly
+    return true;
+}
+
+template<class Encoding>
+void Z3Memory<Encoding>::resetRegions()
+{
+    regions.clear();
+    regionStores.clear();
+    regionsValid = true;
+    unroutedStores = false;
+    flatVals.clear();
+    flatIDs.clear();
+}
+
+/// The store also reaches loc2ValMap, but only once a symbolic access needs it (see flushRegionStores)
+template<class Encoding>
+bool Z3Memory<Encoding>::storeRegion(u32_t id, const z3::expr &addr, const z3::expr &value, z3::expr &mem)
+{
+    MemRegion *region = regionsValid ? getRegion(id, addr) : nullptr;
+    if (!region)
+    {
+        unroutedStores = true;
+        return false;
+    }
+    region->content = region->isArray ? z3::store(region->content, addr, value) : value;
+    regionStores.emplace_back(addr, value);
+    mem = region->content;
+    return true;
+}
+
+template<class Encoding>
+bool Z3Memory<Encoding>::loadRegion(u32_t id, const z3::expr &addr, z3::expr &val)
+{
+    MemRegion *region = regionsValid ? getRegion(id, addr) : nullptr;
+    if (!region)
+        return false;
+    val = region->isArray ? z3::select(region->content, addr) : region->content;
+    return true;
+}
+
+/// Register a field object; a base object that already has a single-cell region becomes an array region
+template<class Encoding>
+void Z3Memory<Encoding>::addField(u32_t fieldID, u32_t base, u32_t offset)
+{
+    memObj2Base.emplace(base, base);
+    memObj2Base[fieldID] = base;
+    if (offset == 0 || !multiCellObjs.insert(base).second)
+        return;
+    auto it = regions.find(base);
+    if (it != regions.end() && !it->second.isArray)
+    {
+        it->second.content = z3::store(getRegionInitMem(), getAddress(base), it->second.content);
+        it->second.isArray = true;
+    }
+}
+
+/// Return the region of a registered object, or nullptr for an unregistered one.
+/// A region is created on the first access to the object, so no store has hit its cells before
+template<class Encoding>
+typename Z3Memory<Encoding>::MemRegion *Z3Memory<Encoding>::getRegion(u32_t id, const z3::expr &addr)
+{
+    auto baseIt = memObj2Base.find(id);
+    if (baseIt == memObj2Base.end())
+        return nullptr;
+    u32_t base = baseIt->second;
+    auto it = regions.find(base);
+    if (it == regions.end())
+    {
+        bool isArray = multiCellObjs.count(base);
+        z3::expr content = isArray ? getRegionInitMem() : z3::select(getRegionInitMem(), addr);
+        it = regions.emplace(base, MemRegion{content, isArray}).first;
+    }
+    return &it->second;
+}
+
+template<class Encoding>
+z3::expr Z3Memory<Encoding>::getFlatCell(u32_t id)
+{
+    if (!flatVals.has(id))
+    {
+        std::string name = "loc2Val_" + std::to_string(id);
+        flatVals.set(id, ctx.constant(name.c_str(), Encoding::getSort(ctx)));
+        flatIDs.push_back(id);
+    }
+    return flatVals.get(id);
+}
+
+template<class Encoding>
+void Z3Memory<Encoding>::addFlatCandidates()
+{
+    std::vector<u32_t> ids;
+    for (const auto &obj : memObj2Base)
+    {
+        if (!flatVals.has(obj.first))
+            ids.push_back(obj.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    for (u32_t id : ids)
+        getFlatCell(id);
+}
+
+/// A load through a symbolic address: ite(addr == &c1, c1, ite(addr == &c2, c2, ... other)) over the cells,
+/// where other is a fresh value for an address outside them (a cell created later starts from a fresh value too)
+template<class Encoding>
+z3::expr Z3Memory<Encoding>::loadFlat(const z3::expr &addr)
+{
+    addFlatCandidates();
+    std::string name = "loc2Val_other_" + std::to_string(flatOtherCounter++);
+    z3::expr val = ctx.constant(name.c_str(), Encoding::getSort(ctx));
+    for (u32_t i = flatIDs.size(); i-- > 0;)
+    {
+        z3::expr cellAddr = getAddress(flatIDs[i]);
+        val = z3::ite(addr == cellAddr, flatVals.get(flatIDs[i]), val);
+    }
+    return val;
+}
+
+/// A store through a symbolic address may hit any cell: c = ite(addr == &c, value, c) for every cell c
+template<class Encoding>
+void Z3Memory<Encoding>::storeFlat(const z3::expr &addr, const z3::expr &value)
+{
+    addFlatCandidates();
+    for (u32_t id : flatIDs)
+    {
+        z3::expr cellAddr = getAddress(id);
+        flatVals.set(id, z3::ite(addr == cellAddr, value, flatVals.get(id)));
+    }
+}
+
+template class SVF::Z3Memory<IntEncoding>;
+template class SVF::Z3Memory<BV32Encoding>;
+template class SVF::Z3Memory<BV64Encoding>;
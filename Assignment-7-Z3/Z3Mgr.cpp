@@ -4,9 +4,13 @@
  */
 
 #include "Z3Mgr.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <set>
+#include <unordered_set>
 #include <sstream>
 
 using namespace SVF;
@@ -14,31 +18,145 @@ using namespace z3;
 using namespace std;
 
 /// Store and Select for Loc2ValMap, i.e., store and load
-/// The address needs to be evaluated to a value before accessing loc2ValMap
-z3::expr Z3Mgr::storeValue(const z3::expr loc, const z3::expr value)
+/// The address needs to be evaluated to a value before accessing loc2ValMap.
+/// Every store also goes to the merged loc2ValMap so that symbolic addresses can always fall back to it; with
+/// RegionMem, a store routed to a region only reaches loc2ValMap when a symbolic access needs it.
+/// storeValue returns the memory the store went to
+template<class Encoding>
+z3::expr GenericZ3Mgr<Encoding>::storeValue(const z3::expr loc, const z3::expr value)
+{
+    if (!instrumented)
+        return doStoreValue(loc, value);
+    Z3Instrumentation::Clock::time_point start = Z3Instrumentation::Clock::now();
+    z3::expr mem = doStoreValue(loc, value);
+    Z3Event event(Z3Event::Store, Z3Instrumentation::elapsedMs(start));
+    event.exprSize = Z3Instrumentation::getDAGSize(loc) + Z3Instrumentation::getDAGSize(value);
+    event.memDepth = storeDepths.get(mem);
+    Z3Instrumentation::getInstance().record(event);
+    return mem;
+}
+
+template<class Encoding>
+z3::expr GenericZ3Mgr<Encoding>::loadValue(const z3::expr loc)
+{
+    if (!instrumented)
+        return doLoadValue(loc);
+    Z3Instrumentation::Clock::time_point start = Z3Instrumentation::Clock::now();
+    z3::expr val = doLoadValue(loc);
+    Z3Event event(Z3Event::Load, Z3Instrumentation::elapsedMs(start));
+    event.exprSize = Z3Instrumentation::getDAGSize(loc) + Z3Instrumentation::getDAGSize(val);
+    // the memory read is the array of the select, unless the load was answered without one (e.g., shadow memory)
+    if (val.is_app() && val.decl().decl_kind() == Z3_OP_SELECT)
+        event.memDepth = storeDepths.get(val.arg(0));
+    Z3Instrumentation::getInstance().record(event);
+    return val;
+}
+
+template<class Encoding>
+z3::expr GenericZ3Mgr<Encoding>::doStoreValue(const z3::expr &loc, const z3::expr &value)
 {
     z3::expr addr = getEvalExpr(loc);
-    assert(isVirtualMemAddress(addr) && "Pointer operand is not a physical address?");
-    z3::expr loc2ValMap = varID2ExprMap[lastSlot];
-    loc2ValMap = z3::store(loc2ValMap, addr, value);
-    varID2ExprMap.set(lastSlot, loc2ValMap);
-    return loc2ValMap;
+    u32_t id;
+    bool concrete = getConcreteAddress(addr, id);
+    assert((concrete || shadowMem || memModel != ArrayMem) && "Pointer operand is not a physical address?");
+    if (concrete && (shadowMem || memModel != ArrayMem) && !isUniqueAddress(loc, addr))
+    {
+        concrete = false;
+        addr = foldQuery(loc);
+    }
+    if (shadowMem)
+    {
+        if (concrete)
+            memory.storeShadow(id, value);
+        else
+            memory.invalidateShadow();   // a symbolic store may overwrite any cell
+    }
+    // the cells replace loc2ValMap, so FlatMem stores never build the store chain
+    if (memModel == FlatMem)
+    {
+        if (concrete)
+            memory.storeFlatCell(id, value);
+        else
+            memory.storeFlat(addr, value);
+        return value;
+    }
+    if (memModel == RegionMem)
+    {
+        z3::expr mem(ctx);
+        if (concrete && memory.storeRegion(id, addr, value, mem))
+            return mem;
+        if (!concrete)
+            memory.invalidateRegions();
+    }
+    return memory.store(addr, value);
 }
 
-z3::expr Z3Mgr::loadValue(const z3::expr loc)
+template<class Encoding>
+z3::expr GenericZ3Mgr<Encoding>::doLoadValue(const z3::expr &loc)
 {
     z3::expr addr = getEvalExpr(loc);
-    assert(isVirtualMemAddress(addr) && "Pointer operand is not a physical address?");
-    z3::expr loc2ValMap = varID2ExprMap[lastSlot];
-    return z3::select(loc2ValMap, addr);
+    u32_t id;
+    bool concrete = getConcreteAddress(addr, id);
+    assert((concrete || shadowMem || memModel != ArrayMem) && "Pointer operand is not a physical address?");
+    if (concrete && (shadowMem || memModel != ArrayMem) && !isUniqueAddress(loc, addr))
+    {
+        concrete = false;
+        addr = foldQuery(loc);
+    }
+    // the cells already hold the stored values, and the shadow memory reads unwritten cells from loc2ValMap
+    if (memModel == FlatMem)
+        return concrete ? memory.getFlatCell(id) : memory.loadFlat(addr);
+    z3::expr val(ctx);
+    if (concrete && shadowMem && memory.loadShadow(id, addr, val))
+        return val;
+    if (concrete && memModel == RegionMem && memory.loadRegion(id, addr, val))
+        return val;
+    // the stores routed to regions cannot alias an unregistered concrete address
+    if (!concrete)
+        memory.flushRegionStores();
+    return memory.load(addr);
+}
+
+/// Return true and the internal id if the evaluated address is a concrete virtual address
+template<class Encoding>
+bool GenericZ3Mgr<Encoding>::getConcreteAddress(const z3::expr &addr, u32_t &id)
+{
+    int64_t val;
+    if (!Encoding::getNumValue(addr, val) || val < 0 || val > 0xffffffff || !isVirtualMemAddress(val))
+        return false;
+    id = getInternalID(val);
+    return true;
+}
+
+/// Whether loc can only be the model value addr: it simplifies to a numeral, or the solver proves loc == addr.
+/// The model value is one solution among possibly many, so routing an access by it to a single cell is only sound
+/// if the address is unique. The proofs are memoized until the solver changes, so repeated accesses through
+/// the same pointer cost one check
+template<class Encoding>
+bool GenericZ3Mgr<Encoding>::isUniqueAddress(const z3::expr &loc, const z3::expr &addr)
+{
+    if (loc.is_numeral() || foldQuery(loc).simplify().is_numeral())
+        return true;
+    if (uniqueAddrsGen != solverGen)
+    {
+        uniqueAddrs.clear();
+        uniqueAddrsGen = solverGen;
+    }
+    auto it = uniqueAddrs.find(loc.id());
+    if (it != uniqueAddrs.end() && z3::eq(it->second.addr, addr))
+        return it->second.unique;
+    bool unique = checkNegateAssert(loc == addr);
+    uniqueAddrs.insert_or_assign(loc.id(), UniqueAddr{loc, addr, unique});
+    return unique;
 }
 
 /// Return int value from an expression if it is a numeral, otherwise return an approximate value
-s32_t Z3Mgr::z3Expr2NumValue(z3::expr e)
+template<class Encoding>
+s32_t GenericZ3Mgr<Encoding>::z3Expr2NumValue(z3::expr e)
 {
-    z3::expr val = getEvalExpr(e);
-    if (val.is_numeral())
-        return val.get_numeral_int64();
+    int64_t val;
+    if (Encoding::getNumValue(getEvalExpr(e), val))
+        return val;
     else
     {
         assert(false && "this expression is not numeral");
@@ -49,27 +167,849 @@ s32_t Z3Mgr::z3Expr2NumValue(z3::expr e)
 /// It checks if the constraints added to the Z3 solver are satisfiable.
 /// If they are, it retrieves the model that satisfies these constraints
 /// and evaluates the given complex expression e within this model, returning the evaluated result
-z3::expr Z3Mgr::getEvalExpr(z3::expr e)
+template<class Encoding>
+z3::expr GenericZ3Mgr<Encoding>::getEvalExpr(z3::expr e)
+{
+    e = foldQuery(e);
+    if (e.is_numeral() || e.is_true() || e.is_false())
+        return e;
+    uint64_t key = 0;
+    if (queryCache.isEnabled())
+    {
+        z3::expr val(ctx);
+        key = queryCache.getKey(constraints, e, false);
+        if (queryCache.lookupValue<Encoding>(key, ctx, val))
+            return val;
+    }
+    z3::expr val(ctx);
+    if (slicer.isEnabled())
+    {
+        z3::expr_vector es(ctx);
+        es.push_back(e);
+        val = getSlicedModel(es).eval(e);
+    }
+    else
+        val = getModel().eval(e);
+    if (trace.isOpen() && modelStatus == Z3Sat)
+    {
+        z3::expr_vector es(ctx);
+        es.push_back(e);
+        trace.eval(es);
+    }
+    if (queryCache.isEnabled())
+        queryCache.insertValue<Encoding>(key, val);
+    return val;
+}
+
+/// Re-check the solver only if it has been changed since the cached model was taken,
+/// so that consecutive evaluations (e.g., in storeValue/loadValue) share one model
+template<class Encoding>
+const z3::model &GenericZ3Mgr<Encoding>::getModel()
+{
+    if (modelGen != solverGen)
+    {
+        if (solverConfig.incremental)
+            cachedModel = checkModel(solver);
+        else
+        {
+            z3::solver oneShot = getOneShotSolver();
+            cachedModel = checkModel(oneShot);
+        }
+        modelGen = solverGen;
+    }
+    return cachedModel;
+}
+
+/// Unsatisfiable constraints are a bug of the caller, whereas unknown (e.g., a timeout) is recorded in
+/// modelStatus and yields an empty model, under which evaluations stay symbolic
+template<class Encoding>
+z3::model GenericZ3Mgr<Encoding>::checkModel(z3::solver &s)
 {
-    z3::check_result res = solver.check();
+    Z3Instrumentation::Clock::time_point start = Z3Instrumentation::Clock::now();
+    z3::check_result res = s.check();
+    if (instrumented || trace.isOpen())
+    {
+        double timeMs = Z3Instrumentation::elapsedMs(start);
+        if (instrumented)
+            recordCheck(s, res, timeMs, nullptr);
+        if (trace.isOpen())
+            trace.check(nullptr, res, timeMs);
+    }
+    if (res == z3::unsat && coreTracking)
+        reportUnsat();
     assert(res != z3::unsat && "unsatisfied constraints! Check your contradictory constraints added to the solver");
-    z3::model m = solver.get_model();
-    return m.eval(e);
+    modelStatus = getCheckStatus(res, res == z3::unknown ? s.reason_unknown() : "");
+    if (modelStatus == Z3Cancelled && solverConfig.timeoutMs != 0)
+        modelStatus = Z3Timeout;
+    if (res != z3::sat)
+        return z3::model(ctx);
+    if (!instrumented)
+        return s.get_model();
+    start = Z3Instrumentation::Clock::now();
+    z3::model m = s.get_model();
+    Z3Event event(Z3Event::GetModel, Z3Instrumentation::elapsedMs(start));
+    event.numAssertions = s.assertions().size();
+    Z3Instrumentation::getInstance().record(event);
+    return m;
+}
+
+template<class Encoding>
+template<class Add, class Push>
+void GenericZ3Mgr<Encoding>::forEachConstraint(Add add, Push push)
+{
+    u32_t nextCon = 0, nextSubst = 0;
+    for (u32_t k = 0; k <= constraintScopes.size(); k++)
+    {
+        u32_t endCon = k < constraintScopes.size() ? constraintScopes[k] : constraints.size();
+        u32_t endSubst = constProp.getScopeStart(k);
+        for (; nextCon < endCon; nextCon++)
+            add(constraints[nextCon]);
+        for (; nextSubst < endSubst; nextSubst++)
+            add(constProp.getVar(nextSubst) == constProp.getValue(nextSubst));
+        if (k < constraintScopes.size())
+            push();
+    }
+}
+
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::setCoreTracking(bool enable)
+{
+    coreTracking = enable;
+    truncateTracked(0);
+    trackedScopes.clear();
+    if (!enable)
+        return;
+    forEachConstraint([this](const z3::expr &e)
+                      {
+                          trackedExprs.push_back(e);
+                          trackedLabels.push_back("");
+                      },
+                      [this]()
+                      {
+                          trackedScopes.push_back(trackedLabels.size());
+                      });
+}
+
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::setIntervalAnalysis(bool enable)
+{
+    intervals.reset(enable ? new Z3IntervalDomain() : nullptr);
+    if (!enable)
+        return;
+    forEachConstraint([this](const z3::expr &e)
+                      {
+                          intervals->assume(e);
+                      },
+                      [this]()
+                      {
+                          intervals->push();
+                      });
+}
+
+/// Deletion-based minimisation: a constraint is dropped if the others are still unsat, in which case the core
+/// shrinks to the new unsat core. Necessity is monotone (a constraint needed by a set is needed by its subsets),
+/// so the constraints kept earlier stay necessary as the core shrinks.
+template<class Encoding>
+UnsatCore GenericZ3Mgr<Encoding>::getUnsatCore(u32_t budgetMs)
+{
+    assert(coreTracking && "enable core tracking before adding the constraints");
+    Z3Instrumentation::Clock::time_point start = Z3Instrumentation::Clock::now();
+    UnsatCore core;
+    z3::solver s = mkSolver(ctx, false);
+    z3::expr_vector indicators(ctx);
+    std::unordered_map<unsigned, u32_t> indicator2Index;
+    for (u32_t i = 0; i < trackedExprs.size(); i++)
+    {
+        std::string name = "__core_" + std::to_string(i);
+        z3::expr p = ctx.bool_const(name.c_str());
+        s.add(z3::implies(p, trackedExprs[i]));
+        indicators.push_back(p);
+        indicator2Index[p.id()] = i;
+    }
+    // the indices of a core, in the order the constraints were added
+    auto getCore = [&]()
+    {
+        z3::expr_vector unsatCore = s.unsat_core();
+        std::vector<u32_t> indices;
+        for (u32_t i = 0; i < unsatCore.size(); i++)
+            indices.push_back(indicator2Index.at(unsatCore[i].id()));
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    };
+    // the remaining budget for the next check (at least 1 ms), or 0 if it has run out
+    auto remainingMs = [&]() -> u32_t
+    {
+        if (budgetMs == 0)
+            return UINT32_MAX;
+        double elapsed = Z3Instrumentation::elapsedMs(start);
+        return elapsed >= budgetMs ? 0 : std::max<u32_t>(budgetMs - elapsed, 1);
+    };
+
+    core.res = s.check(indicators);
+    std::vector<u32_t> indices;
+    if (core.res == z3::unsat)
+    {
+        indices = getCore();
+        u32_t i = 0;
+        while (i < indices.size())
+        {
+            u32_t remaining = remainingMs();
+            if (remaining == 0)
+                break;
+            if (budgetMs != 0)
+            {
+                z3::params params(ctx);
+                params.set("timeout", remaining);
+                s.set(params);
+            }
+            z3::expr_vector assumptions(ctx);
+            for (u32_t j = 0; j < indices.size(); j++)
+            {
+                if (j != i)
+                    assumptions.push_back(indicators[indices[j]]);
+            }
+            z3::check_result res = s.check(assumptions);
+            if (res == z3::unsat)
+            {
+                // the new core is a subset of the assumptions, so indices[0..i) are all still in it
+                indices = getCore();
+            }
+            else if (res == z3::sat)
+                i++;
+            else
+                break;
+        }
+        // an unsat check always has a non-empty core, unless the solver does not track the assumptions
+        core.minimal = !indices.empty() && i == indices.size();
+    }
+    for (u32_t idx : indices)
+    {
+        CoreStatement stmt;
+        stmt.index = idx;
+        stmt.label = trackedLabels[idx].empty() ? trackedExprs[idx].to_string() : trackedLabels[idx];
+        getMemSites(trackedExprs[idx], stmt.sites);
+        core.statements.push_back(stmt);
+    }
+    core.timeMs = Z3Instrumentation::elapsedMs(start);
+    return core;
+}
+
+/// Loads are listed in the order they are found, each followed by the stores (oldest first) of the memory it reads
+/// that have not been listed yet
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::getMemSites(const z3::expr &e, std::vector<std::string> &sites) const
+{
+    std::unordered_set<unsigned> visited;
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty())
+    {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!visited.insert(cur.id()).second || !cur.is_app())
+            continue;
+        if (cur.decl().decl_kind() == Z3_OP_SELECT)
+        {
+            sites.push_back("load *" + describeAddr(cur.arg(1)));
+            std::vector<std::string> stores;
+            z3::expr mem = cur.arg(0);
+            while (mem.is_app() && mem.decl().decl_kind() == Z3_OP_STORE && visited.insert(mem.id()).second)
+            {
+                stores.push_back("store *" + describeAddr(mem.arg(1)) + " = " + mem.arg(2).to_string());
+                todo.push_back(mem.arg(1));
+                todo.push_back(mem.arg(2));
+                mem = mem.arg(0);
+            }
+            sites.insert(sites.end(), stores.rbegin(), stores.rend());
+            todo.push_back(cur.arg(1));
+            continue;
+        }
+        for (u32_t i = 0; i < cur.num_args(); i++)
+            todo.push_back(cur.arg(i));
+    }
+}
+
+/// A concrete virtual address in hex (as in printExprValues), any other address as an expression
+template<class Encoding>
+std::string GenericZ3Mgr<Encoding>::describeAddr(const z3::expr &addr) const
+{
+    int64_t val;
+    if (Encoding::getNumValue(addr, val) && val > 0 && val <= 0xffffffff && ((u32_t) val & AddressMask) == AddressMask)
+    {
+        std::stringstream hex;
+        hex << "0x" << std::hex << val;
+        return hex.str();
+    }
+    return addr.to_string();
+}
+
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::reportUnsat()
+{
+    UnsatCore core = getUnsatCore(DefaultCoreBudgetMs);
+    if (core.res != z3::unsat)
+        return;
+    std::cerr << "unsat core" << (core.minimal ? "" : " (not minimal)") << ":\n";
+    for (const CoreStatement &stmt : core.statements)
+    {
+        std::cerr << "  [" << stmt.index << "] " << stmt.label << "\n";
+        for (const std::string &site : stmt.sites)
+            std::cerr << "      " << site << "\n";
+    }
+}
+
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::recordCheck(const z3::solver &s, z3::check_result res, double timeMs, const z3::expr *q)
+{
+    Z3Event event(Z3Event::Check, timeMs);
+    std::stringstream result;
+    result << res;
+    event.result = result.str();
+    event.exprSize = q ? Z3Instrumentation::getDAGSize(*q) : 0;
+    event.numAssertions = s.assertions().size();
+    Z3Instrumentation::fillStatistics(event, s);
+    Z3Instrumentation::getInstance().record(event);
+}
+
+/// Evaluate all expressions against one model: the cached model, or the model of their joint
+/// cone of influence if slicing is enabled. With the query cache, only the expressions missing
+/// from the cache are evaluated (and the model is not computed at all if none is missing).
+template<class Encoding>
+EvalValues GenericZ3Mgr<Encoding>::getEvalValues(const z3::expr_vector &origEs)
+{
+    EvalValues vals;
+    vals.values.resize(origEs.size(), 0);
+    vals.isNumeral.resize(origEs.size(), false);
+
+    z3::expr_vector es(ctx);
+    for (u32_t i = 0; i < origEs.size(); i++)
+        es.push_back(foldQuery(origEs[i]));
+
+    std::vector<uint64_t> keys(es.size(), 0);
+    std::vector<u32_t> misses;
+    z3::expr_vector missed(ctx);
+    for (u32_t i = 0; i < es.size(); i++)
+    {
+        int64_t v;
+        if (Encoding::getNumValue(es[i], v))
+        {
+            vals.values[i] = v;
+            vals.isNumeral[i] = true;
+            continue;
+        }
+        Z3QueryCache::Entry entry;
+        if (queryCache.isEnabled())
+        {
+            keys[i] = queryCache.getKey(constraints, es[i], false);
+            if (queryCache.lookup(keys[i], entry))
+            {
+                if (entry.kind == Z3QueryCache::Entry::Numeral)
+                {
+                    vals.values[i] = entry.value;
+                    vals.isNumeral[i] = true;
+                }
+                continue;
+            }
+        }
+        misses.push_back(i);
+        missed.push_back(es[i]);
+    }
+    if (misses.empty())
+        return vals;
+
+    const z3::model &m = slicer.isEnabled() ? getSlicedModel(missed) : getModel();
+    if (trace.isOpen() && modelStatus == Z3Sat)
+        trace.eval(missed);
+    for (u32_t i : misses)
+    {
+        z3::expr val = m.eval(es[i]);
+        int64_t v;
+        if (Encoding::getNumValue(val, v))
+        {
+            vals.values[i] = v;
+            vals.isNumeral[i] = true;
+        }
+        if (queryCache.isEnabled())
+            queryCache.insertValue<Encoding>(keys[i], val);
+    }
+    return vals;
+}
+
+/// Evaluate the expressions of an ID range; IDs without an expression are skipped (see EvalValues::ids)
+template<class Encoding>
+EvalValues GenericZ3Mgr<Encoding>::getEvalValues(u32_t beginID, u32_t endID)
+{
+    assert(beginID <= endID && "invalid ID range!");
+    z3::expr_vector es(ctx);
+    std::vector<u32_t> ids;
+    varID2ExprMap.forEach(beginID, endID, [&](u32_t id, const z3::expr &e)
+    {
+        es.push_back(e);
+        ids.push_back(id);
+    });
+    EvalValues vals = getEvalValues(es);
+    vals.ids = std::move(ids);
+    return vals;
+}
+
+/// Check a batch of assertions in one scope of the solver, or in a scratch solver holding
+/// the cone of influence of all the assertions if slicing is enabled (all constraints in one-shot mode).
+/// A single assertion adds nothing to the solver, so it is checked without a scope
+template<class Encoding>
+std::vector<AssertCheckResult> GenericZ3Mgr<Encoding>::checkUncachedAsserts(const z3::expr_vector &qs, bool withCex)
+{
+    if (slicer.isEnabled())
+    {
+        z3::solver sliced = getSlicedSolver(qs);
+        return checkGuardedAsserts(sliced, qs, withCex);
+    }
+    if (!solverConfig.incremental)
+    {
+        z3::solver oneShot = getOneShotSolver();
+        return checkGuardedAsserts(oneShot, qs, withCex);
+    }
+    if (qs.size() == 1)
+        return checkGuardedAsserts(solver, qs, withCex);
+    pushSolver();
+    std::vector<AssertCheckResult> results = checkGuardedAsserts(solver, qs, withCex);
+    popSolver();
+    return results;
+}
+
+/// With constant propagation, assertions folded to true hold without calling Z3, and assertions folded to
+/// false are refuted by the cached model (if any). With the interval pre-analysis, the remaining assertions are
+/// first decided by the intervals. With the query cache, only the assertions whose verdicts
+/// are not cached are sent to Z3; a cached counterexample verdict is not used if a counterexample is requested.
+template<class Encoding>
+std::vector<AssertCheckResult> GenericZ3Mgr<Encoding>::checkNegateAsserts(const z3::expr_vector &origQs, bool withCex)
+{
+    if (!queryCache.isEnabled() && constProp.getNumSubstitutions() == 0 && !intervals)
+        return checkUncachedAsserts(origQs, withCex);
+
+    std::vector<AssertCheckResult> results(origQs.size(), AssertCheckResult(z3::unknown, 0));
+    std::vector<uint64_t> keys(origQs.size(), 0);
+    std::vector<u32_t> misses;
+    z3::expr_vector missed(ctx);
+    for (u32_t i = 0; i < origQs.size(); i++)
+    {
+        z3::expr q = foldQuery(origQs[i]);
+        if (q.is_true())
+        {
+            results[i] = AssertCheckResult(z3::unsat, 0);
+            continue;
+        }
+        bool modelCached = modelGen == solverGen && modelStatus == Z3Sat;
+        if (q.is_false() && modelCached)
+        {
+            results[i] = AssertCheckResult(z3::sat, 0);
+            if (withCex)
+                results[i].cex = cachedModel;
+            continue;
+        }
+        if (intervals)
+        {
+            Z3IntervalDomain::Verdict verdict = intervals->check(q);
+            if (verdict == Z3IntervalDomain::Holds)
+            {
+                results[i] = AssertCheckResult(z3::unsat, 0);
+                intervalStats.proved++;
+                continue;
+            }
+            // a false assertion has a counterexample iff the constraints are satisfiable
+            if (verdict == Z3IntervalDomain::Fails && (modelCached || (intervals->isExact() && !withCex)))
+            {
+                results[i] = AssertCheckResult(z3::sat, 0);
+                if (withCex)
+                    results[i].cex = cachedModel;
+                intervalStats.refuted++;
+                continue;
+            }
+            intervalStats.undecided++;
+        }
+        Z3QueryCache::Entry entry;
+        if (queryCache.isEnabled())
+        {
+            keys[i] = queryCache.getKey(constraints, q, true);
+            if (queryCache.lookup(keys[i], entry) && (entry.kind == Z3QueryCache::Entry::Unsat || !withCex))
+            {
+                results[i] = AssertCheckResult(entry.kind == Z3QueryCache::Entry::Unsat ? z3::unsat : z3::sat, 0);
+                continue;
+            }
+        }
+        misses.push_back(i);
+        missed.push_back(q);
+    }
+    if (misses.empty())
+        return results;
+
+    std::vector<AssertCheckResult> checked = checkUncachedAsserts(missed, withCex);
+    for (u32_t j = 0; j < misses.size(); j++)
+    {
+        u32_t i = misses[j];
+        results[i] = checked[j];
+        if (queryCache.isEnabled() && checked[j].res != z3::unknown)
+            queryCache.insertVerdict(keys[i], checked[j].res == z3::unsat);
+    }
+    return results;
+}
+
+/// The constraints (or their cone of influence) and the assertions are translated into the private context of the
+/// job on the calling thread; the checking thread then only uses that context, and the handle translates the
+/// counterexamples back
+template<class Encoding>
+Z3CheckHandle GenericZ3Mgr<Encoding>::checkNegateAssertsAsync(const z3::expr_vector &qs, std::shared_ptr<Z3CheckControl> control,
+                                                              bool withCex)
+{
+    z3::expr_vector folded(ctx);
+    for (u32_t i = 0; i < qs.size(); i++)
+        folded.push_back(foldQuery(qs[i]));
+    std::vector<u32_t> ids;
+    if (slicer.isEnabled())
+        getConeOfInfluence(folded, ids);
+    else
+    {
+        for (u32_t i = 0; i < constraints.size(); i++)
+            ids.push_back(i);
+    }
+    z3::expr_vector cs(ctx);
+    for (u32_t i : ids)
+        cs.push_back(constraints[i]);
+
+    std::shared_ptr<Z3AsyncJob> job = std::make_shared<Z3AsyncJob>();
+    job->solver = mkSolver(job->ctx);
+    z3::expr_vector translated(job->ctx, cs);
+    for (u32_t i = 0; i < translated.size(); i++)
+        job->solver.add(translated[i]);
+    job->qs = z3::expr_vector(job->ctx, folded);
+    z3::expr_vector pool(job->ctx);
+    job->assumptions = addGuardedAsserts(job->solver, job->qs, pool);
+
+    u32_t timeoutMs = solverConfig.timeoutMs;
+    bool instr = instrumented;
+    std::future<std::vector<AssertCheckResult>> results = std::async(std::launch::async,
+            [job, control, withCex, timeoutMs, instr]()
+            {
+                return checkAssumptions(job->solver, job->assumptions, job->qs, withCex, timeoutMs, instr, control.get());
+            });
+    return Z3CheckHandle(ctx, job, control, std::move(results));
+}
+
+/// The caller is responsible for discarding the guarded constraints afterwards, which frees the guards for the
+/// next batch
+template<class Encoding>
+z3::expr_vector GenericZ3Mgr<Encoding>::addGuardedAsserts(z3::solver &s, const z3::expr_vector &qs, z3::expr_vector &pool)
+{
+    z3::context &c = s.ctx();
+    z3::expr_vector assumptions(c);
+    if (qs.size() == 1)
+    {
+        assumptions.push_back(!qs[0]);
+        return assumptions;
+    }
+    for (u32_t i = 0; i < qs.size(); i++)
+    {
+        while (pool.size() <= i)
+        {
+            std::string name = "__assert_guard_" + std::to_string(pool.size());
+            pool.push_back(c.bool_const(name.c_str()));
+        }
+        s.add(z3::implies(pool[i], !qs[i]));
+        assumptions.push_back(pool[i]);
+    }
+    return assumptions;
+}
+
+/// Each ¬Q is added as (guard_i => ¬Q_i); checking under the assumption guard_i then decides Q_i alone.
+/// A single ¬Q is the assumption itself, so nothing is added to s.
+template<class Encoding>
+std::vector<AssertCheckResult> GenericZ3Mgr<Encoding>::checkGuardedAsserts(z3::solver &s, const z3::expr_vector &qs, bool withCex)
+{
+    // a scratch solver only holds (a cone of) the traced constraints, so its guards are scoped in the trace
+    bool scratch = &s != &solver;
+    if (trace.isOpen() && scratch)
+        trace.push();
+    z3::expr_vector assumptions = addGuardedAsserts(s, qs, guardPool);
+    if (trace.isOpen())
+    {
+        for (u32_t i = 0; i < qs.size(); i++)
+        {
+            if (qs.size() == 1)
+                trace.declare(assumptions[i]);
+            else
+                trace.assertExpr(z3::implies(assumptions[i], !qs[i]));
+        }
+    }
+
+    std::vector<AssertCheckResult> results = checkAssumptions(s, assumptions, qs, withCex, solverConfig.timeoutMs,
+                                                              instrumented, nullptr);
+    if (trace.isOpen())
+    {
+        for (u32_t i = 0; i < results.size(); i++)
+        {
+            z3::expr assumption = assumptions[i];
+            trace.check(&assumption, results[i].res, results[i].timeMs);
+        }
+        if (scratch)
+            trace.pop(1);
+    }
+    return results;
+}
+
+template<class Encoding>
+std::vector<AssertCheckResult> GenericZ3Mgr<Encoding>::checkAssumptions(z3::solver &s, const z3::expr_vector &assumptions,
+                                                                       const z3::expr_vector &qs, bool withCex,
+                                                                       u32_t timeoutMs, bool instrumented,
+                                                                       Z3CheckControl *control)
+{
+    std::vector<AssertCheckResult> results;
+    results.reserve(qs.size());
+    for (u32_t i = 0; i < assumptions.size(); i++)
+    {
+        if (control && control->isCancelled())
+        {
+            results.emplace_back(Z3Cancelled);
+            continue;
+        }
+        if (control && control->hasDeadline)
+        {
+            u32_t remaining = control->remainingMs();
+            if (remaining == 0)
+            {
+                results.emplace_back(Z3Timeout);
+                continue;
+            }
+            if (timeoutMs != 0)
+                remaining = std::min(remaining, timeoutMs);
+            s.set("timeout", remaining);
+        }
+        z3::expr_vector assumption(s.ctx());
+        assumption.push_back(assumptions[i]);
+        if (control && !control->beginCheck())
+        {
+            results.emplace_back(Z3Cancelled);
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        z3::check_result res = s.check(assumption);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (control)
+            control->endCheck();
+        if (instrumented)
+        {
+            z3::expr q = qs[i];
+            recordCheck(s, res, elapsed.count(), &q);
+        }
+        results.emplace_back(res, elapsed.count(), res == z3::unknown ? s.reason_unknown() : "");
+        // Z3 may report an expired timeout as "canceled"; a cancellation not requested through control is a timeout
+        bool timed = timeoutMs != 0 || (control && control->hasDeadline);
+        if (results.back().status == Z3Cancelled && timed && !(control && control->isCancelled()))
+            results.back().status = Z3Timeout;
+        if (withCex && res == z3::sat)
+        {
+            auto modelStart = std::chrono::steady_clock::now();
+            results.back().cex = s.get_model();
+            if (instrumented)
+            {
+                Z3Event event(Z3Event::GetModel, Z3Instrumentation::elapsedMs(modelStart));
+                event.numAssertions = s.assertions().size();
+                Z3Instrumentation::getInstance().record(event);
+            }
+        }
+    }
+    return results;
+}
+
+/// Fold e with the known constants, see Z3ConstantPropagation::addConstraint; a new definition changes the values
+/// of the folded queries, so it invalidates the cached model
+template<class Encoding>
+bool GenericZ3Mgr<Encoding>::propagateConstraint(z3::expr &e)
+{
+    u32_t numSubst = constProp.getNumSubstitutions();
+    bool send = constProp.addConstraint(e, [this](const z3::expr &cur, std::vector<uint64_t> &syms)
+    {
+        collectSymbols(cur, syms);
+    });
+    if (constProp.getNumSubstitutions() != numSubst)
+        invalidateModel();
+    return send;
+}
+
+/// Collect the symbols (variables) of an expression.
+/// A variable registered through updateZ3Expr is keyed by its SVFVar ID (loc2ValMap by its slot),
+/// any other uninterpreted constant by its AST id above the 32-bit ID range.
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::collectSymbols(const z3::expr &e, std::vector<uint64_t> &syms) const
+{
+    std::unordered_set<unsigned> visited;
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty())
+    {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!visited.insert(cur.id()).second || !cur.is_app())
+            continue;
+        if (isSymbol(cur))
+        {
+            u32_t idx;
+            if (getVarID(cur, idx))
+                syms.push_back(idx);
+            else
+                syms.push_back(((uint64_t) 1 << 32) | cur.id());
+            continue;
+        }
+        for (u32_t i = 0; i < cur.num_args(); i++)
+            todo.push_back(cur.arg(i));
+    }
+}
+
+/// Drop the constraints (and their index entries) beyond the first num ones, e.g., when popping a scope
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::truncateConstraints(u32_t num)
+{
+    slicer.truncate(num);
+    queryCache.truncate(num);
+    constraints.resize(num);
+}
+
+/// The index is extended to the constraints added since the last query
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::getConeOfInfluence(const z3::expr_vector &es, std::vector<u32_t> &coi)
+{
+    auto collect = [this](const z3::expr &e, std::vector<uint64_t> &syms)
+    {
+        collectSymbols(e, syms);
+    };
+    slicer.index(constraints, collect);
+    std::vector<uint64_t> syms;
+    for (u32_t i = 0; i < es.size(); i++)
+        collectSymbols(es[i], syms);
+    slicer.getConeOfInfluence(std::move(syms), coi);
+}
+
+/// Return a scratch solver holding the cone of influence of the given expressions
+template<class Encoding>
+z3::solver GenericZ3Mgr<Encoding>::getSlicedSolver(const z3::expr_vector &es)
+{
+    std::vector<u32_t> coi;
+    getConeOfInfluence(es, coi);
+    return getScratchSolver(coi);
+}
+
+/// Return a model of the cone of influence of the given expressions.
+/// The last sliced model is reused if the solver is unchanged and the cone is the same.
+template<class Encoding>
+const z3::model &GenericZ3Mgr<Encoding>::getSlicedModel(const z3::expr_vector &es)
+{
+    std::vector<u32_t> coi;
+    getConeOfInfluence(es, coi);
+    if (const z3::model *m = slicer.getModel(solverGen, coi))
+        return *m;
+
+    z3::solver sliced = getScratchSolver(coi);
+    return slicer.setModel(solverGen, coi, checkModel(sliced));
+}
+
+/// Return a fresh solver holding the given constraints of the constraint log
+template<class Encoding>
+z3::solver GenericZ3Mgr<Encoding>::getScratchSolver(const std::vector<u32_t> &ids)
+{
+    z3::solver scratch = mkSolver();
+    for (u32_t i : ids)
+        scratch.add(constraints[i]);
+    return scratch;
+}
+
+/// One-shot mode: the constraints of all scopes are asserted at once, so no scope is left in the solver
+template<class Encoding>
+z3::solver GenericZ3Mgr<Encoding>::getOneShotSolver()
+{
+    z3::solver oneShot = mkSolver();
+    for (u32_t i = 0; i < constraints.size(); i++)
+        oneShot.add(constraints[i]);
+    return oneShot;
+}
+
+/// A tactic pipeline is turned into a solver with tactic::mk_solver; otherwise a solver for the logic
+/// (or Z3's default solver) is created. Timeout and resource limit are set as solver parameters.
+template<class Encoding>
+z3::solver GenericZ3Mgr<Encoding>::mkSolver(z3::context &c, bool withTactics) const
+{
+    z3::solver s(c);
+    if (withTactics && !solverConfig.tactics.empty())
+    {
+        z3::tactic pipeline(c, solverConfig.tactics[0].c_str());
+        for (u32_t i = 1; i < solverConfig.tactics.size(); i++)
+            pipeline = pipeline & z3::tactic(c, solverConfig.tactics[i].c_str());
+        s = pipeline.mk_solver();
+    }
+    else if (solverConfig.logic == "auto")
+        s = z3::solver(c, Encoding::logic);
+    else if (!solverConfig.logic.empty())
+        s = z3::solver(c, solverConfig.logic.c_str());
+
+    if (solverConfig.timeoutMs != 0 || solverConfig.rlimit != 0)
+    {
+        z3::params p(c);
+        if (solverConfig.timeoutMs != 0)
+            p.set("timeout", solverConfig.timeoutMs);
+        if (solverConfig.rlimit != 0)
+            p.set("rlimit", solverConfig.rlimit);
+        s.set(p);
+    }
+    return s;
+}
+
+/// Rebuild the solver and replay the constraint log, pushing a scope at every recorded scope boundary
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::setSolverConfig(const Z3SolverConfig &config)
+{
+    solverConfig = config;
+    solver = mkSolver();
+    u32_t next = 0;
+    for (u32_t scope : constraintScopes)
+    {
+        for (; next < scope; next++)
+            solver.add(constraints[next]);
+        solver.push();
+    }
+    for (; next < constraints.size(); next++)
+        solver.add(constraints[next]);
+    invalidateModel();
+}
+
+/// The current session state is replayed first, so that the trace is self-contained
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::setTrace(const std::string &file)
+{
+    trace.close();
+    if (file.empty() || !trace.open(file, Encoding::name))
+        return;
+    u32_t next = 0;
+    for (u32_t scope : constraintScopes)
+    {
+        for (; next < scope; next++)
+            trace.assertExpr(constraints[next]);
+        trace.push();
+    }
+    for (; next < constraints.size(); next++)
+        trace.assertExpr(constraints[next]);
 }
 
 /// Print all expressions' values after evaluation
-void Z3Mgr::printExprValues()
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::printExprValues()
 {
+    EvalValues vals = getEvalValues(0, varID2ExprMap.bound());
     std::cout.flags(std::ios::left);
     std::cout << "-----------Var and Value-----------\n";
-    for (u32_t i = 0; i < lastSlot; i++)
+    for (u32_t i = 0; i < vals.ids.size(); i++)
     {
-        expr e = getEvalExpr(varID2ExprMap[i]);
-        if (e.is_numeral())
+        if (vals.isNumeral[i])
         {
-            s32_t value = e.get_numeral_int64();
+            s32_t value = vals.values[i];
             std::stringstream exprName;
-            exprName << "Var" << i;
+            exprName << "Var" << vals.ids[i];
             std::cout << std::setw(25) << exprName.str();
             if (isVirtualMemAddress(value))
                 std::cout << "\t Value: " << std::hex << "0x" << value << "\n";
@@ -80,7 +1020,77 @@ void Z3Mgr::printExprValues()
     std::cout << "-----------------------------------------\n";
 }
 
-void Z3Mgr::printZ3Exprs()
+template<class Encoding>
+void GenericZ3Mgr<Encoding>::printZ3Exprs()
 {
     std::cout << solver << "\n";
-}
\ No newline at end of file
+    for (u32_t i = 0; i < constProp.getNumSubstitutions(); i++)
+        std::cout << "; propagated: " << constProp.getVar(i) << " = " << constProp.getValue(i) << "\n";
+}
+
+static void invalidSolverConfig(const std::string &entry)
+{
+    std::cerr << "invalid solver configuration entry: '" << entry << "'\n";
+    abort();
+}
+
+static u32_t parseSolverConfigNum(const std::string &entry, const std::string &val)
+{
+    char *end = nullptr;
+    unsigned long num = std::strtoul(val.c_str(), &end, 10);
+    if (val.empty() || *end != '\0')
+        invalidSolverConfig(entry);
+    return num;
+}
+
+Z3SolverConfig Z3SolverConfig::parse(const std::string &spec)
+{
+    Z3SolverConfig config;
+    std::stringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        if (entry.empty())
+            continue;
+        size_t eq = entry.find('=');
+        if (eq == std::string::npos)
+            invalidSolverConfig(entry);
+        std::string key = entry.substr(0, eq);
+        std::string val = entry.substr(eq + 1);
+        if (key == "logic")
+            config.logic = val;
+        else if (key == "tactics")
+        {
+            config.tactics.clear();
+            if (val == "default")
+                config.tactics = defaultTactics();
+            else
+            {
+                std::stringstream names(val);
+                std::string name;
+                while (std::getline(names, name, '+'))
+                    if (!name.empty())
+                        config.tactics.push_back(name);
+            }
+        }
+        else if (key == "timeout")
+            config.timeoutMs = parseSolverConfigNum(entry, val);
+        else if (key == "rlimit")
+            config.rlimit = parseSolverConfigNum(entry, val);
+        else if (key == "incremental")
+            config.incremental = parseSolverConfigNum(entry, val) != 0;
+        else
+            invalidSolverConfig(entry);
+    }
+    return config;
+}
+
+Z3SolverConfig Z3SolverConfig::fromEnv(const char *var)
+{
+    const char *spec = std::getenv(var);
+    return spec ? parse(spec) : Z3SolverConfig();
+}
+
+template class SVF::GenericZ3Mgr<IntEncoding>;
+template class SVF::GenericZ3Mgr<BV32Encoding>;
+template class SVF::GenericZ3Mgr<BV64Encoding>;
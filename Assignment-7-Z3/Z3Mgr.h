@@ -6,12 +6,31 @@
 #ifndef ANSWERS_DEV_Z3MGR_H
 #define ANSWERS_DEV_Z3MGR_H
 
+#include "Z3ConstantPropagation.h"
+#include "Z3Instrumentation.h"
+#include "Z3IntervalDomain.h"
+#include "Z3QueryCache.h"
+#include "Z3Slicing.h"
+#include "Z3Trace.h"
 #include "z3++.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace SVF
 {
@@ -31,15 +50,593 @@ namespace SVF
 typedef unsigned u32_t;
 typedef signed s32_t;
 
-/// Z3 manager interface
-class Z3Mgr
+/// Outcome of a solver check, where z3::unknown is split by its reason
+enum Z3CheckStatus
+{
+    Z3Sat,
+    Z3Unsat,
+    Z3Unknown,      ///< incomplete theory, resource limit, ...
+    Z3Timeout,      ///< the timeout or the deadline expired
+    Z3Cancelled     ///< interrupted through Z3_interrupt
+};
+
+/// Return the status of a check result; reason is the solver's reason_unknown() if r is z3::unknown
+inline Z3CheckStatus getCheckStatus(z3::check_result r, const std::string &reason = "")
+{
+    if (r == z3::sat)
+        return Z3Sat;
+    if (r == z3::unsat)
+        return Z3Unsat;
+    if (reason.find("timeout") != std::string::npos)
+        return Z3Timeout;
+    if (reason.find("interrupt") != std::string::npos || reason.find("cancel") != std::string::npos)
+        return Z3Cancelled;
+    return Z3Unknown;
+}
+
+/// Verdict of checking one assertion Q, i.e., the satisfiability of ¬Q under the current constraints
+struct AssertCheckResult
+{
+    z3::check_result res;           /// unsat: Q holds; sat: there is a counterexample
+    Z3CheckStatus status;           /// res, and why if res == unknown
+    std::optional<z3::model> cex;   /// a counterexample (only if requested and res == sat)
+    double timeMs;                  /// wall time of the check in milliseconds
+
+    AssertCheckResult(z3::check_result r, double t, const std::string &reason = "")
+            : res(r), status(getCheckStatus(r, reason)), timeMs(t)
+    {}
+
+    /// A result that is not backed by any solver check (e.g., skipped after a cancellation)
+    AssertCheckResult(Z3CheckStatus s) : res(s == Z3Sat ? z3::sat : s == Z3Unsat ? z3::unsat : z3::unknown), status(s),
+            timeMs(0)
+    {}
+
+    inline bool holds() const
+    {
+        return res == z3::unsat;
+    }
+};
+
+/// Deadline and cancellation of an asynchronous check, shared by the checking thread and the handle.
+/// Z3_interrupt only stops a running check, and an interrupt arriving between checks makes the next
+/// push of the context fail, so interrupts are only sent while a check is running.
+class Z3CheckControl
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point deadline;
+    bool hasDeadline;
+
+    Z3CheckControl() : hasDeadline(false), cancelled(false), running(false)
+    {}
+
+    /// Remaining time in milliseconds (at least 1 if the deadline has not passed, 0 if it has)
+    inline u32_t remainingMs() const
+    {
+        Clock::time_point now = Clock::now();
+        if (deadline <= now)
+            return 0;
+        int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        return std::max<int64_t>(1, std::min<int64_t>(left, UINT32_MAX - 1));
+    }
+
+    inline bool isCancelled()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled;
+    }
+
+    /// Called by the checking thread around each check; beginCheck returns false if the checks are cancelled
+    ///@{
+    inline bool beginCheck()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = !cancelled;
+        return running;
+    }
+    inline void endCheck()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    ///@}
+
+    /// Cancel the checks and interrupt the running one (repeatedly, as an interrupt that arrives
+    /// before Z3 starts listening is lost); return once no check is running
+    inline void cancel(z3::context &ctx)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running)
+                    return;
+                ctx.interrupt();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    std::mutex mutex;
+    bool cancelled;
+    bool running;
+};
+
+/// The private context of an asynchronous check, with the solver and the assertions translated into it.
+/// Only the checking thread uses the context while the checks run, so the manager stays usable meanwhile.
+struct Z3AsyncJob
+{
+    z3::context ctx;
+    z3::solver solver;
+    z3::expr_vector qs;
+    z3::expr_vector assumptions;    /// one per assertion, deciding it alone
+
+    Z3AsyncJob() : solver(ctx), qs(ctx), assumptions(ctx)
+    {}
+};
+
+/// Handle of an asynchronous check of GenericZ3Mgr.
+/// The checks run on another thread in a private context (see Z3AsyncJob), so the manager can be used while they
+/// run; destroying the handle waits for the checks.
+class Z3CheckHandle
+{
+public:
+    Z3CheckHandle(z3::context &c, std::shared_ptr<Z3AsyncJob> j, std::shared_ptr<Z3CheckControl> ctl,
+                  std::future<std::vector<AssertCheckResult>> f)
+            : ctx(&c), job(j), control(ctl), results(std::move(f))
+    {}
+
+    /// Return true if all checks have finished
+    inline bool ready() const
+    {
+        return results.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// Wait until all checks have finished or the time point has passed; return ready()
+    inline bool waitUntil(Z3CheckControl::Clock::time_point t) const
+    {
+        return results.wait_until(t) == std::future_status::ready;
+    }
+
+    /// Interrupt the running check (via Z3_interrupt) and skip the remaining ones; both are reported as
+    /// Z3Cancelled. Returns once the running check has stopped.
+    inline void cancel()
+    {
+        control->cancel(job->ctx);
+    }
+
+    /// Wait for and return one result per checked assertion, with the counterexamples in the manager's context
+    inline std::vector<AssertCheckResult> get()
+    {
+        std::vector<AssertCheckResult> res = results.get();
+        for (AssertCheckResult &r : res)
+        {
+            if (r.cex)
+            {
+                z3::model cex(*r.cex, *ctx, z3::model::translate());
+                r.cex.emplace(cex);
+            }
+        }
+        return res;
+    }
+
+private:
+    z3::context *ctx;
+    std::shared_ptr<Z3AsyncJob> job;    /// declared before results, so it outlives the checking thread
+    std::shared_ptr<Z3CheckControl> control;
+    std::future<std::vector<AssertCheckResult>> results;
+};
+
+/// Values of a batch evaluation; values[i] is only meaningful if isNumeral[i] is set.
+/// For an ID range, only the IDs holding an expression are evaluated, and ids[i] is the SVFVar ID of values[i]
+struct EvalValues
+{
+    std::vector<int64_t> values;
+    std::vector<bool> isNumeral;
+    std::vector<u32_t> ids;
+};
+
+/// Assertions decided by the interval pre-analysis (see GenericZ3Mgr::setIntervalAnalysis)
+struct IntervalStats
+{
+    u32_t proved;       /// assertions shown to hold without Z3
+    u32_t refuted;      /// assertions shown to fail without Z3
+    u32_t undecided;    /// assertions left to the query cache and Z3
+
+    IntervalStats() : proved(0), refuted(0), undecided(0)
+    {}
+};
+
+/// A constraint of an unsat core, as the statement that added it
+struct CoreStatement
+{
+    u32_t index;                    /// position in the tracked constraints (see GenericZ3Mgr::setCoreTracking)
+    std::string label;              /// the label given to addToSolver, or the constraint itself
+    std::vector<std::string> sites; /// memory accesses of the constraint, e.g., "load *0x7f000002", "store *0x7f000001 = q"
+};
+
+/// Result of GenericZ3Mgr::getUnsatCore
+struct UnsatCore
+{
+    z3::check_result res;                   /// result of checking all tracked constraints; the core is empty unless unsat
+    std::vector<CoreStatement> statements;  /// the core, in the order the constraints were added
+    bool minimal;                           /// whether every statement was shown necessary within the time budget
+    double timeMs;                          /// wall time of the extraction and minimisation
+
+    UnsatCore() : res(z3::unknown), minimal(false), timeMs(0)
+    {}
+};
+
+/// Configuration of the solvers created by GenericZ3Mgr.
+/// The default configuration is a plain incremental z3::solver with Z3's default settings.
+/// It can also be read from the environment variable Z3MGR_SOLVER_CONFIG, a comma-separated list of
+/// key=value pairs, e.g., "logic=auto,tactics=default,timeout=1000,rlimit=0,incremental=0":
+///   logic        a logic name (e.g., QF_AUFLIA), "auto" for the logic of the encoding, or empty for Z3's default
+///   tactics      "default" for simplify+solve-eqs+propagate-values+smt, a '+'-separated tactic list, or empty
+///   timeout      timeout of each check in milliseconds (0 for none)
+///   rlimit       resource limit of each check (0 for none)
+///   incremental  1: keep one solver and use push/pop; 0: check every query on a fresh solver (one-shot)
+struct Z3SolverConfig
+{
+    std::string logic;                  /// the logic to solve in; tactics take precedence if both are set
+    std::vector<std::string> tactics;   /// tactic pipeline, applied in order
+    u32_t timeoutMs;
+    u32_t rlimit;
+    bool incremental;
+
+    Z3SolverConfig() : timeoutMs(0), rlimit(0), incremental(true)
+    {}
+
+    /// The tactic pipeline tuned for the regular constraint shapes of Z3Mgr
+    static std::vector<std::string> defaultTactics()
+    {
+        return {"simplify", "solve-eqs", "propagate-values", "smt"};
+    }
+
+    /// Return true if this configuration creates the same solver as z3::solver(ctx)
+    inline bool isDefault() const
+    {
+        return logic.empty() && tactics.empty() && timeoutMs == 0 && rlimit == 0 && incremental;
+    }
+
+    /// Parse "key=value,key=value,..."; unknown keys and malformed values abort
+    static Z3SolverConfig parse(const std::string &spec);
+
+    /// Read the configuration from the environment variable (the default configuration if it is unset)
+    static Z3SolverConfig fromEnv(const char *var = "Z3MGR_SOLVER_CONFIG");
+};
+
+/// A growable map from SVFVar IDs to z3 expressions.
+/// IDs are grouped into fixed-size chunks that are only allocated once one of their IDs is set,
+/// so sparse IDs (anywhere below AddressMask) do not require allocating the whole range upfront.
+class ChunkedExprMap
+{
+public:
+    static const u32_t ChunkBits = 12;
+    static const u32_t ChunkSize = 1 << ChunkBits;
+
+    explicit ChunkedExprMap(z3::context &c) : ctx(c)
+    {}
+
+    /// Return true if an expression has been set for id
+    inline bool has(u32_t id) const
+    {
+        u32_t chunk = id >> ChunkBits;
+        return chunk < chunks.size() && chunks[chunk] &&
+               Z3_ast_vector_get(ctx, *chunks[chunk], id & (ChunkSize - 1)) != nullptr;
+    }
+
+    inline z3::expr get(u32_t id) const
+    {
+        assert(has(id) && "no expression for this id!");
+        return (*chunks[id >> ChunkBits])[id & (ChunkSize - 1)];
+    }
+
+    inline void set(u32_t id, z3::expr e)
+    {
+        u32_t chunk = id >> ChunkBits;
+        if (chunk >= chunks.size())
+            chunks.resize(chunk + 1);
+        if (!chunks[chunk])
+        {
+            chunks[chunk].reset(new z3::expr_vector(ctx));
+            chunks[chunk]->resize(ChunkSize);
+        }
+        chunks[chunk]->set(id & (ChunkSize - 1), e);
+    }
+
+    /// Call f(id, e) on each id in [begin, end) that has an expression e, in increasing order.
+    /// Only the allocated chunks are visited, so sparse id ranges (e.g., field or address ids) stay cheap
+    template<class F>
+    void forEach(u32_t begin, u32_t end, F f) const
+    {
+        u32_t lastChunk = std::min<uint64_t>(chunks.size(), ((uint64_t) end + ChunkSize - 1) >> ChunkBits);
+        for (u32_t chunk = begin >> ChunkBits; chunk < lastChunk; chunk++)
+        {
+            if (!chunks[chunk])
+                continue;
+            u32_t base = chunk << ChunkBits;
+            u32_t from = std::max(begin, base) - base;
+            u32_t to = std::min<uint64_t>(end, (uint64_t) base + ChunkSize) - base;
+            for (u32_t i = from; i < to; i++)
+            {
+                if (Z3_ast a = Z3_ast_vector_get(ctx, *chunks[chunk], i))
+                    f(base + i, z3::expr(ctx, a));
+            }
+        }
+    }
+
+    /// Return an upper bound (exclusive) of the ids set so far
+    inline u32_t bound() const
+    {
+        return chunks.size() << ChunkBits;
+    }
+
+    /// Reserve room for the chunk table of ids up to num
+    inline void reserve(u32_t num)
+    {
+        chunks.reserve((num >> ChunkBits) + 1);
+    }
+
+    inline void clear()
+    {
+        chunks.clear();
+    }
+
+private:
+    z3::context &ctx;
+    std::vector<std::unique_ptr<z3::expr_vector>> chunks;
+};
+
+/// Encoding policies of GenericZ3Mgr: the sort of values and addresses (including the domain and range of
+/// loc2ValMap), numerals, and numeral extraction. Arithmetic and comparison operators follow the sort of their
+/// operands (signed comparisons for bit-vectors), so the encoding is fixed at compile time without any runtime branch.
+///@{
+/// Unbounded mathematical integers (QF_AUFLIA)
+struct IntEncoding
+{
+    static constexpr const char *name = "Int";
+    static constexpr const char *logic = "QF_AUFLIA";
+
+    static inline z3::sort getSort(z3::context &ctx)
+    {
+        return ctx.int_sort();
+    }
+    static inline z3::expr getVal(z3::context &ctx, int64_t val)
+    {
+        return ctx.int_val(val);
+    }
+    static inline bool getNumValue(const z3::expr &e, int64_t &val)
+    {
+        return e.is_numeral_i64(val);
+    }
+};
+
+/// Fixed-width two's complement bit-vectors (QF_AUFBV)
+template<u32_t Width>
+struct BVEncoding
+{
+    static constexpr const char *name = Width == 32 ? "BV32" : "BV64";
+    static constexpr const char *logic = "QF_AUFBV";
+
+    static inline z3::sort getSort(z3::context &ctx)
+    {
+        return ctx.bv_sort(Width);
+    }
+    static inline z3::expr getVal(z3::context &ctx, int64_t val)
+    {
+        return ctx.bv_val(val, Width);
+    }
+    /// Numerals of bit-vectors are unsigned, so sign-extend them to int64_t
+    static inline bool getNumValue(const z3::expr &e, int64_t &val)
+    {
+        uint64_t uval;
+        if (!e.is_numeral_u64(uval))
+            return false;
+        if (Width < 64 && ((uval >> (Width - 1)) & 1))
+            uval |= ~(uint64_t) 0 << (Width % 64);
+        val = (int64_t) uval;
+        return true;
+    }
+};
+typedef BVEncoding<32> BV32Encoding;
+typedef BVEncoding<64> BV64Encoding;
+
+#if defined(Z3MGR_ENCODING_BV32)
+typedef BV32Encoding DefaultEncoding;
+#elif defined(Z3MGR_ENCODING_BV64)
+typedef BV64Encoding DefaultEncoding;
+#else
+typedef IntEncoding DefaultEncoding;
+#endif
+///@}
+
+/// The memory of GenericZ3Mgr: the merged loc2ValMap array, and the state of the memory models over it, i.e., the
+/// concrete shadow memory, the regions of RegionMem and the cells of FlatMem. Addresses are evaluated by the manager,
+/// which passes the internal id of a concrete address, and chooses the memory model of every access.
+template<class Encoding>
+class Z3Memory
+{
+public:
+    explicit Z3Memory(z3::context &c)
+            : ctx(c), loc2ValMap(c), initLoc2ValMap(c), shadowValid(true), shadowVals(c),
+              regionsValid(true), unroutedStores(false), flatVals(c), flatOtherCounter(0)
+    {}
+
+    /// Create the loc2ValMap constant (reset must follow)
+    inline void init()
+    {
+        initLoc2ValMap = ctx.constant("loc2ValMap", ctx.array_sort(Encoding::getSort(ctx), Encoding::getSort(ctx)));
+    }
+
+    /// Drop all stores and registered objects, keeping the loc2ValMap constant
+    void reset();
+
+    /// The merged memory, which every store and symbolic access goes through (unless routed to a region)
+    ///@{
+    /// Return loc2ValMap with all stores applied
+    inline const z3::expr &getLoc2ValMap()
+    {
+        flushRegionStores();
+        return loc2ValMap;
+    }
+    inline z3::expr store(const z3::expr &addr, const z3::expr &value)
+    {
+        loc2ValMap = z3::store(loc2ValMap, addr, value);
+        return loc2ValMap;
+    }
+    inline z3::expr load(const z3::expr &addr) const
+    {
+        return z3::select(loc2ValMap, addr);
+    }
+    ///@}
+
+    /// Register an abstract object, or a field (offset > 0) of a base object, by internal ids
+    ///@{
+    inline void addObj(u32_t id)
+    {
+        memObj2Base.emplace(id, id);
+    }
+    void addField(u32_t fieldID, u32_t baseID, u32_t offset);
+    ///@}
+
+    /// Shadow memory: the values stored to concrete addresses, valid until a store through a symbolic address
+    ///@{
+    inline void resetShadow()
+    {
+        shadowValid = true;
+        shadowVals.clear();
+    }
+    inline void storeShadow(u32_t id, const z3::expr &value)
+    {
+        shadowVals.set(id, value);
+    }
+    inline void invalidateShadow()
+    {
+        shadowValid = false;
+    }
+    /// Return false if the shadow memory is invalid, otherwise the value at concrete address addr
+    bool loadShadow(u32_t id, const z3::expr &addr, z3::expr &val) const;
+    ///@}
+
+    /// RegionMem: one region per registered base object, valid until a store through a symbolic address
+    ///@{
+    /// Drop the regions and the FlatMem cells
+    void resetRegions();
+    /// Route a store to concrete address addr to its region, and return the region in mem; return false if the
+    /// store must go to loc2ValMap (an unregistered object, or the regions are invalid)
+    bool storeRegion(u32_t id, const z3::expr &addr, const z3::expr &value, z3::expr &mem);
+    /// Return false if the load from concrete address addr must go to loc2ValMap
+    bool loadRegion(u32_t id, const z3::expr &addr, z3::expr &val);
+    /// A store through a symbolic address may hit any region: the later accesses all go to loc2ValMap
+    inline void invalidateRegions()
+    {
+        flushRegionStores();
+        regionsValid = false;
+    }
+    /// Apply the stores routed to a region since the last call to loc2ValMap, which symbolic accesses go through
+    inline void flushRegionStores()
+    {
+        for (const std::pair<z3::expr, z3::expr> &st : regionStores)
+            loc2ValMap = z3::store(loc2ValMap, st.first, st.second);
+        regionStores.clear();
+    }
+    ///@}
+
+    /// FlatMem: one value per cell, without the array theory
+    ///@{
+    /// The current value of a cell, starting from an uninterpreted constant for its initial value
+    z3::expr getFlatCell(u32_t id);
+    inline void storeFlatCell(u32_t id, const z3::expr &value)
+    {
+        getFlatCell(id);
+        flatVals.set(id, value);
+    }
+    z3::expr loadFlat(const z3::expr &addr);
+    void storeFlat(const z3::expr &addr, const z3::expr &value);
+    ///@}
+
+private:
+    /// Memory of one abstract object and its fields
+    struct MemRegion
+    {
+        z3::expr content;   /// the value of a single-cell object, or an address -> value array otherwise
+        bool isArray;
+    };
+
+    /// Return the region of a registered object, or nullptr for an unregistered one
+    MemRegion *getRegion(u32_t id, const z3::expr &addr);
+    /// The memory a new region starts from: the initial memory unless some store bypassed the regions
+    inline const z3::expr &getRegionInitMem() const
+    {
+        return unroutedStores ? loc2ValMap : initLoc2ValMap;
+    }
+    /// FlatMem: make every registered object a cell, in the order of their ids
+    void addFlatCandidates();
+    /// The virtual address of an internal id
+    inline z3::expr getAddress(u32_t id) const
+    {
+        return Encoding::getVal(ctx, AddressMask + id);
+    }
+
+    z3::context &ctx;
+    z3::expr loc2ValMap;            /// the memory: address -> stored value
+    z3::expr initLoc2ValMap;        /// the memory before any store
+    bool shadowValid;               /// false once a store through a symbolic address may have hit any shadowed cell
+    ChunkedExprMap shadowVals;      /// internal id of an address -> value last stored there
+    bool regionsValid;              /// false once a store through a symbolic address may have hit any region
+    bool unroutedStores;            /// whether a concrete store went to an unregistered object
+    std::vector<std::pair<z3::expr, z3::expr>> regionStores;   /// (address, value) of the stores routed to a region, not yet in loc2ValMap
+    std::unordered_map<u32_t, MemRegion> regions;   /// base object id -> its memory region
+    std::unordered_map<u32_t, u32_t> memObj2Base;   /// registered object/field id -> base object id
+    std::unordered_set<u32_t> multiCellObjs;        /// base objects that have fields
+    ChunkedExprMap flatVals;                        /// FlatMem: internal id of a cell -> its current value
+    std::vector<u32_t> flatIDs;                     /// FlatMem: the cells, in the order they were created
+    u32_t flatOtherCounter;                         /// FlatMem: number of values read outside the cells so far
+};
+
+/// Z3 manager interface, parameterized by an encoding policy
+template<class Encoding>
+class GenericZ3Mgr
 {
 public:
+    /// Memory models used by storeValue/loadValue
+    enum MemModel
+    {
+        ArrayMem,   ///< one loc2ValMap array for the whole memory
+        RegionMem,  ///< one region (an array, or a scalar for single-cell objects) per abstract object
+        FlatMem     ///< one value per memory cell, without the array theory (loads through symbolic addresses are ite chains)
+    };
+
     /// Constructor
-    Z3Mgr(u32_t numOfMapElems)
-            : solver(ctx), varID2ExprMap(ctx), lastSlot(numOfMapElems)
+    /// numOfMapElems is only a hint of the number of SVFVars; the expression map grows on demand
+    GenericZ3Mgr(u32_t numOfMapElems = 0)
+            : solver(ctx), varID2ExprMap(ctx), memory(ctx),
+              cachedModel(ctx), solverGen(1), modelGen(0), modelStatus(Z3Sat), uniqueAddrsGen(0),
+              shadowMem(false), guardPool(ctx),
+              constraints(ctx), slicer(ctx),
+              memModel(ArrayMem),
+              constProp(ctx), coreTracking(false), trackedExprs(ctx),
+              instrumented(Z3Instrumentation::getInstance().isEnabled()),
+              lightReset(false), freshAfter(DefaultFreshAfter), sessionConstraints(0)
     {
+        varID2ExprMap.reserve(numOfMapElems);
         resetZ3ExprMap();
+        setSolverConfig(Z3SolverConfig::fromEnv());
+        if (const char *cacheFile = std::getenv("Z3MGR_QUERY_CACHE"))
+            setQueryCache(DefaultQueryCacheCapacity, cacheFile);
+        if (const char *traceFile = std::getenv("Z3MGR_TRACE"))
+        {
+            static std::atomic<u32_t> numTraces(0);
+            u32_t n = numTraces++;
+            setTrace(n == 0 ? traceFile : std::string(traceFile) + "." + std::to_string(n));
+        }
     }
 
     /// reset and reinitialize Z3Exprs.
@@ -47,15 +644,70 @@ public:
     /// loc2ValMap: maps an address location to its stored value, e.g., loc2ValMap[addr] = val
     inline void resetZ3ExprMap()
     {
-        varID2ExprMap.resize(lastSlot + 1);
-        z3::expr loc2ValMap = ctx.constant("loc2ValMap", ctx.array_sort(ctx.int_sort(), ctx.int_sort()));
-        updateZ3Expr(lastSlot, loc2ValMap);
+        memory.init();
+        resetMemory();
+    }
+
+    /// Drop all stores and registered objects, keeping the loc2ValMap constant
+    inline void resetMemory()
+    {
+        memory.reset();
+        storeDepths.clear();
     }
 
-    /// Store and Select for Loc2ValMap, i.e., store and load
+    /// Enable/disable the concrete shadow memory.
+    /// When enabled, values stored to concrete virtual addresses are also kept in a dense vector indexed by
+    /// getInternalID(addr), and loads from such addresses return the stored value directly instead of a
+    /// select over loc2ValMap. Symbolic addresses still go through the array theory.
+    inline void setShadowMemory(bool enable)
+    {
+        shadowMem = enable;
+        memory.resetShadow();
+    }
+
+    /// Select the memory model (ArrayMem by default); this resets the memory regions.
+    /// FlatMem stores only reach its cells, so they are dropped when switching to another model
+    inline void setMemModel(MemModel model)
+    {
+        memory.flushRegionStores();
+        memModel = model;
+        memory.resetRegions();
+    }
+
+    inline MemModel getMemModel() const
+    {
+        return memModel;
+    }
+
+    /// Register an abstract object, or a field (offset > 0) of a base object.
+    /// In the RegionMem model, the accesses to a registered object or its fields go to the region of the
+    /// base object; accesses to unregistered or symbolic addresses go to the merged loc2ValMap.
+    /// In the FlatMem model, the registered objects and fields are the cells a symbolic address may point to.
+    ///@{
+    inline void addMemObj(u32_t objID)
+    {
+        memory.addObj(getInternalID(objID));
+    }
+    inline void addGepObj(u32_t gepObjID, u32_t baseObjID, u32_t offset)
+    {
+        memory.addField(getInternalID(gepObjID), getInternalID(baseObjID), offset);
+    }
+    ///@}
+
+    /// Store and Select for Loc2ValMap, i.e., store and load.
+    /// storeValue returns the updated memory (loc2ValMap or a region); FlatMem leaves loc2ValMap alone and
+    /// returns the stored value
     z3::expr storeValue(const z3::expr loc, const z3::expr value);
     z3::expr loadValue(const z3::expr loc);
 
+    /// Record (or stop recording) the solver checks, model extractions, stores and loads of this manager in
+    /// Z3Instrumentation; the default is Z3Instrumentation::getInstance().isEnabled()
+    inline void setInstrumentation(bool enable)
+    {
+        instrumented = enable;
+        storeDepths.clear();
+    }
+
     /// The physical address starts with 0x7f...... + idx
     inline u32_t getVirtualMemAddress(u32_t idx) const
     {
@@ -91,17 +743,51 @@ public:
     inline z3::expr getZ3Expr(u32_t idx) const
     {
         assert(getInternalID(idx) == idx && "SVFVar idx overflow > 0x7f000000?");
-        assert(varID2ExprMap.size() >= idx + 1 && "idx out of bound for map access, increase map size!");
-        return varID2ExprMap[getInternalID(idx)];
+        return varID2ExprMap.get(getInternalID(idx));
     }
 
     /// Update expression when assignments
+    /// With constant propagation, a non-variable target is folded with the constants known so far
     inline void updateZ3Expr(u32_t idx, z3::expr target)
     {
-        assert(varID2ExprMap.size() >= idx + 1 && "idx out of bound for map access, increase map size!");
+        assert(getInternalID(idx) == idx && "SVFVar idx overflow > 0x7f000000?");
+        if (isSymbol(target))
+            astID2VarID.insert_or_assign(target.id(), DeclaredVar{target, idx});
+        else if (constProp.isEnabled())
+            target = constProp.propagate(target);
         varID2ExprMap.set(getInternalID(idx), target);
     }
 
+    /// Return true if an expression has been set for the SVFVar ID
+    inline bool hasZ3Expr(u32_t idx) const
+    {
+        return varID2ExprMap.has(getInternalID(idx));
+    }
+
+    /// Return an upper bound (exclusive) of the SVFVar IDs having an expression
+    inline u32_t getZ3ExprIDBound() const
+    {
+        return varID2ExprMap.bound();
+    }
+
+    /// Return the current memory, i.e., loc2ValMap with all stores applied
+    inline const z3::expr &getLoc2ValMap()
+    {
+        return memory.getLoc2ValMap();
+    }
+
+    /// Return true if e is the constant of a variable set through updateZ3Expr, and get the SVFVar ID it was set for.
+    /// The ID stays the same when the variable is later set to another expression, as the constraints using e
+    /// still refer to that variable
+    inline bool getVarID(const z3::expr &e, u32_t &idx) const
+    {
+        auto it = astID2VarID.find(e.id());
+        if (it == astID2VarID.end())
+            return false;
+        idx = it->second.idx;
+        return true;
+    }
+
     /// Return int value from an expression if it is a numeral, otherwise return an approximate value
     s32_t z3Expr2NumValue(z3::expr e);
 
@@ -110,12 +796,249 @@ public:
     /// and evaluates the given complex expression e within this model, returning the evaluated result
     z3::expr getEvalExpr(z3::expr e);
 
+    /// Return a model of the constraints currently in the solver (an empty one if the check is not sat, see getModelStatus).
+    /// The model is cached and only recomputed after the solver has been changed via
+    /// addToSolver/pushSolver/popSolver/resetSolverState (or after invalidateModel)
+    const z3::model &getModel();
+
+    /// Evaluate a batch of expressions against a single model (one solver check at most)
+    EvalValues getEvalValues(const z3::expr_vector &es);
+
+    /// Evaluate the expressions of the SVFVar IDs in [beginID, endID) that have one against a single model
+    EvalValues getEvalValues(u32_t beginID, u32_t endID);
+
+    /// Drop the cached model; call this after modifying the solver directly through getSolver()
+    inline void invalidateModel()
+    {
+        ++solverGen;
+    }
+
+    /// Add an z3 expression into solver for later satisfiability solving
+    /// With constant propagation, e is folded first and definitional equalities are turned into substitutions.
+    /// With core tracking, e (before folding) is recorded with the label that names it in unsat cores.
+    inline void addToSolver(z3::expr e, const std::string &label = "")
+    {
+        if (coreTracking)
+        {
+            trackedExprs.push_back(e);
+            trackedLabels.push_back(label);
+        }
+        if (intervals)
+            intervals->assume(e);
+        if (constProp.isEnabled() && !propagateConstraint(e))
+            return;
+        solver.add(e);
+        constraints.push_back(e);
+        invalidateModel();
+        if (trace.isOpen())
+            trace.assertExpr(e);
+    }
+
+    /// Create a new scope / remove the top n scopes of the solver
+    ///@{
+    inline void pushSolver()
+    {
+        solver.push();
+        constraintScopes.push_back(constraints.size());
+        constProp.push();
+        if (coreTracking)
+            trackedScopes.push_back(trackedLabels.size());
+        if (intervals)
+            intervals->push();
+        invalidateModel();
+        if (trace.isOpen())
+            trace.push();
+    }
+    inline void popSolver(u32_t n = 1)
+    {
+        assert(constraintScopes.size() >= n && "pop more scopes than pushed?");
+        solver.pop(n);
+        truncateConstraints(constraintScopes[constraintScopes.size() - n]);
+        constraintScopes.resize(constraintScopes.size() - n);
+        constProp.pop(n);
+        if (coreTracking)
+        {
+            truncateTracked(trackedScopes[trackedScopes.size() - n]);
+            trackedScopes.resize(trackedScopes.size() - n);
+        }
+        if (intervals)
+            intervals->pop(n);
+        invalidateModel();
+        if (trace.isOpen())
+            trace.pop(n);
+    }
+    ///@}
+
+    /// Enable/disable constant propagation in addToSolver/updateZ3Expr.
+    /// When enabled, known constants and addresses are substituted into every added constraint, which is then
+    /// folded with simplify(). A constraint folded to (var == numeral) defines var: it is recorded in the
+    /// substitution map and only sent to the solver if var already occurs in the solver; a constraint folded to
+    /// true is dropped. Queries (getEvalExpr, getEvalValues, checkNegateAssert(s)) are folded the same way, so
+    /// the values of propagated variables are still reported, and folded assertions may be decided without Z3.
+    inline void setConstantPropagation(bool enable)
+    {
+        constProp.setEnabled(enable);
+    }
+
+    /// Substitute the propagated constants into e and fold it
+    inline z3::expr propagateConstants(z3::expr e)
+    {
+        return constProp.propagate(e);
+    }
+
+    /// Enable/disable core tracking. When enabled, every constraint added through addToSolver is recorded as it
+    /// was given (before constant propagation) together with its label, and each scope of the record is popped
+    /// with the solver. Enabling starts the record from the current constraints, without labels.
+    /// The solver itself is unchanged: the indicators are only created by getUnsatCore.
+    void setCoreTracking(bool enable);
+
+    /// Return a minimised unsat core of the tracked constraints (core tracking must be enabled).
+    /// Each tracked constraint c_i is added as (p_i => c_i) with a fresh Boolean indicator p_i to a scratch solver,
+    /// which is checked assuming all p_i. If unsat, the core is minimised by dropping one constraint at a time and
+    /// re-checking, until every remaining constraint is necessary or budgetMs (0: no limit) runs out; the
+    /// statements of a non-minimal core still form an unsat core. A core also tells which constraints a later
+    /// query may leave out.
+    UnsatCore getUnsatCore(u32_t budgetMs = 0);
+
+    /// Enable/disable the interval pre-analysis. When enabled, the constraints added through addToSolver (as given)
+    /// are also assumed in a Z3IntervalDomain, and checkNegateAssert(s) first decide each assertion with it: an
+    /// assertion that holds under the intervals is proved without Z3, and one that is false under them is refuted
+    /// without Z3 if the constraints are known to be satisfiable (they only define variables as constants, or a
+    /// model is cached) and no counterexample is requested. Enabling starts from the current constraints.
+    void setIntervalAnalysis(bool enable);
+
+    /// Number of assertions proved, refuted and left undecided by the interval pre-analysis
+    inline const IntervalStats &getIntervalStats() const
+    {
+        return intervalStats;
+    }
+
+    /// Set the solver configuration.
+    /// The solver is rebuilt and the constraints and scopes added through addToSolver/pushSolver are replayed
+    void setSolverConfig(const Z3SolverConfig &config);
+
+    inline const Z3SolverConfig &getSolverConfig() const
+    {
+        return solverConfig;
+    }
+
+    /// Create a solver (without any constraint) as configured by the solver configuration, in the manager's
+    /// context or in context c. Without withTactics the tactic pipeline is ignored: solvers made from tactics
+    /// answer check(assumptions) but return empty unsat cores
+    ///@{
+    inline z3::solver mkSolver()
+    {
+        return mkSolver(ctx);
+    }
+    z3::solver mkSolver(z3::context &c, bool withTactics = true) const;
+    ///@}
+
+    /// Enable the query cache with the given capacity (0 disables it).
+    /// getEvalExpr, getEvalValues and checkNegateAssert(s) look up the structural hash of the constraints added
+    /// through addToSolver and of the query before calling Z3. Like slicing, a cached value may come from a
+    /// different model of the same constraints than the current one.
+    /// If file is not empty, the cache is loaded from it and saved back to it when the cache is destroyed.
+    /// The environment variable Z3MGR_QUERY_CACHE enables the cache with its value as the file.
+    inline void setQueryCache(u32_t capacity, const std::string &file = "")
+    {
+        queryCache.enable(capacity, file);
+    }
+
+    inline Z3QueryCache *getQueryCache() const
+    {
+        return queryCache.getCache();
+    }
+
+    /// Enable/disable lightweight session resets (see resetSession); this resets the solver state, and when enabled,
+    /// pushes the base scope of the first session. freshAfter is the number of constraints, summed over sessions,
+    /// after which resetSession resets the solver itself.
+    inline void setLightweightReset(bool enable, u32_t freshAfter = DefaultFreshAfter)
+    {
+        lightReset = enable;
+        this->freshAfter = freshAfter;
+        sessionConstraints = 0;
+        resetSolverState();
+        if (enable)
+            pushSolver();
+    }
+
+    inline bool isLightweightReset() const
+    {
+        return lightReset;
+    }
+
+    /// Discard the constraints and stores of the current session, keeping the declarations and the expressions of
+    /// the variables: the scopes are popped down to below the base scope, which is pushed again. Popped constraints
+    /// still leave internal state (e.g., internalized atoms) in a long-lived solver, so once freshAfter constraints
+    /// went through it, the solver is reset instead.
+    inline void resetSession()
+    {
+        assert(lightReset && "enable lightweight resets first");
+        sessionConstraints += constraints.size();
+        if (sessionConstraints >= freshAfter || constraintScopes.empty())
+        {
+            resetSolverState();
+            sessionConstraints = 0;
+        }
+        else
+            popSolver(constraintScopes.size());
+        pushSolver();
+        resetMemory();
+    }
+
+    /// Remove all constraints and scopes from the solver
+    inline void resetSolverState()
+    {
+        solver.reset();
+        truncateConstraints(0);
+        constraintScopes.clear();
+        constProp.reset();
+        truncateTracked(0);
+        trackedScopes.clear();
+        if (intervals)
+            intervals->reset();
+        invalidateModel();
+        if (trace.isOpen())
+            trace.reset();
+    }
+
+    /// Record the session (add, push, pop, reset, check and eval) as an SMT-LIB2 script into file, which can be
+    /// re-run by the z3replay tool; an empty file name stops recording. Checks are followed by a comment with
+    /// their result and time, e.g., "; sat 1.25 ms". The environment variable Z3MGR_TRACE enables recording for
+    /// every manager: the first one writes to its value, the next ones to "<value>.1", "<value>.2", ...
+    void setTrace(const std::string &file);
+
+    /// Enable/disable cone-of-influence slicing.
+    /// When enabled, evaluations and assertion checks only send the constraints that (transitively) share
+    /// a variable or the memory (loc2ValMap) with the queried expressions to a scratch solver.
+    /// Constraints must be added through addToSolver to be taken into account.
+    inline void setSlicing(bool enable)
+    {
+        slicer.setEnabled(enable);
+    }
+
+    /// Return the constraints (added through addToSolver) that the value of the given expressions depends on
+    void getConeOfInfluence(const z3::expr_vector &es, std::vector<u32_t> &coi);
+
     /// Print all expressions' values after evaluation
     void printExprValues();
 
     // Print all Z3 expressions
     void printZ3Exprs();
 
+    /// Return the constraints added through addToSolver (in all scopes), including the definitions
+    /// turned into substitutions by constant propagation, e.g., to move them to another context
+    inline z3::expr_vector getConstraints() const
+    {
+        // a copied expr_vector shares its elements with the original, so the log is copied element by element
+        z3::expr_vector cons(constraints.ctx());
+        for (u32_t i = 0; i < constraints.size(); i++)
+            cons.push_back(constraints[i]);
+        for (u32_t i = 0; i < constProp.getNumSubstitutions(); i++)
+            cons.push_back(constProp.getVar(i) == constProp.getValue(i));
+        return cons;
+    }
+
     /// Return the z3 solver
     inline z3::solver &getSolver()
     {
@@ -131,8 +1054,8 @@ public:
     // Clean up the maps
     inline void clearVarID2ExprMap()
     {
-        while (!varID2ExprMap.empty())
-            varID2ExprMap.pop_back();
+        varID2ExprMap.clear();
+        astID2VarID.clear();
 
         resetZ3ExprMap();
     }
@@ -141,13 +1064,42 @@ public:
     // return true means there is no counterexample, false means there is at least one counterexample
     bool checkNegateAssert(z3::expr q)
     {
-        // negative check
-        getSolver().push();
-        getSolver().add(!q);
-        getSolver().check();
-        bool res = getSolver().check() == z3::unsat;
-        getSolver().pop();
-        return res;
+        z3::expr_vector qs(ctx);
+        qs.push_back(q);
+        return checkNegateAsserts(qs)[0].holds();
+    }
+
+    /// Check a batch of assertions in one solver scope.
+    /// Each ¬Q is guarded by a Boolean indicator and checked with solver.check(assumptions), so the solver keeps
+    /// what it learned across the assertions of the batch; the indicators are reused by later batches. A single
+    /// assertion is checked with ¬Q itself as the assumption, without any scope, so the cached model stays valid.
+    /// Counterexample models are only kept if withCex is set.
+    std::vector<AssertCheckResult> checkNegateAsserts(const z3::expr_vector &qs, bool withCex = false);
+
+    /// Check a batch of assertions asynchronously on a scratch solver holding the current constraints (their cone
+    /// of influence if slicing is enabled), translated into a private context; the query cache is bypassed. If a
+    /// deadline is given, each check runs with the remaining time as its timeout and the assertions left at the
+    /// deadline are reported as Z3Timeout. The handle can cancel the checks.
+    ///@{
+    inline Z3CheckHandle checkNegateAssertsAsync(const z3::expr_vector &qs, bool withCex = false)
+    {
+        return checkNegateAssertsAsync(qs, std::make_shared<Z3CheckControl>(), withCex);
+    }
+    inline Z3CheckHandle checkNegateAssertsAsync(const z3::expr_vector &qs, Z3CheckControl::Clock::time_point deadline,
+                                                 bool withCex = false)
+    {
+        std::shared_ptr<Z3CheckControl> control = std::make_shared<Z3CheckControl>();
+        control->deadline = deadline;
+        control->hasDeadline = true;
+        return checkNegateAssertsAsync(qs, control, withCex);
+    }
+    ///@}
+
+    /// Return the status of the check that the current model comes from.
+    /// If it is not Z3Sat (e.g., Z3Timeout), the model is empty and evaluations return non-numeral expressions.
+    inline Z3CheckStatus getModelStatus() const
+    {
+        return modelStatus;
     }
 
 public:
@@ -155,89 +1107,242 @@ public:
     z3::solver solver;
 
 private:
-    z3::expr_vector varID2ExprMap;    /// var to z3 expression
-    u32_t lastSlot;        /// the last slot in the map for the z3 expression.
+    /// Memory helpers
+    ///@{
+    bool getConcreteAddress(const z3::expr &addr, u32_t &id);
+    bool isUniqueAddress(const z3::expr &loc, const z3::expr &addr);
+    ///@}
+
+    /// Cone-of-influence slicing helpers
+    ///@{
+    static inline bool isSymbol(const z3::expr &e)
+    {
+        return e.is_const() && !e.is_numeral() && e.decl().decl_kind() == Z3_OP_UNINTERPRETED;
+    }
+    void collectSymbols(const z3::expr &e, std::vector<uint64_t> &syms) const;
+    void truncateConstraints(u32_t num);
+    const z3::model &getSlicedModel(const z3::expr_vector &es);
+    z3::solver getSlicedSolver(const z3::expr_vector &es);
+    ///@}
+
+    /// A fresh solver holding the given constraints of the constraint log
+    z3::solver getScratchSolver(const std::vector<u32_t> &ids);
+    /// A fresh solver holding all the constraints of the constraint log (one-shot mode)
+    z3::solver getOneShotSolver();
+
+    std::vector<AssertCheckResult> checkGuardedAsserts(z3::solver &s, const z3::expr_vector &qs, bool withCex);
+    /// Add (guard_i => ¬Q_i) to s for each assertion, with the guards taken from pool (grown as needed), and return
+    /// one assumption per assertion; a single ¬Q is its own assumption and adds nothing to s
+    static z3::expr_vector addGuardedAsserts(z3::solver &s, const z3::expr_vector &qs, z3::expr_vector &pool);
+    /// Check s under each assumption in turn, the i-th deciding qs[i]. It only uses the context of s, so it can run
+    /// on any thread that owns that context
+    static std::vector<AssertCheckResult> checkAssumptions(z3::solver &s, const z3::expr_vector &assumptions,
+                                                           const z3::expr_vector &qs, bool withCex, u32_t timeoutMs,
+                                                           bool instrumented, Z3CheckControl *control);
+    Z3CheckHandle checkNegateAssertsAsync(const z3::expr_vector &qs, std::shared_ptr<Z3CheckControl> control, bool withCex);
+    /// Check s for a model; an empty model is returned if s is not satisfiable
+    z3::model checkModel(z3::solver &s);
+    z3::expr doStoreValue(const z3::expr &loc, const z3::expr &value);
+    z3::expr doLoadValue(const z3::expr &loc);
+    /// Record a check of s (for a model if q is null) that took timeMs
+    static void recordCheck(const z3::solver &s, z3::check_result res, double timeMs, const z3::expr *q);
+    std::vector<AssertCheckResult> checkUncachedAsserts(const z3::expr_vector &qs, bool withCex);
+
+    /// Call add on each constraint and substitution equality, and push at each scope, in the order they were added
+    template<class Add, class Push>
+    void forEachConstraint(Add add, Push push);
+
+    /// Unsat core helpers
+    ///@{
+    inline void truncateTracked(u32_t num)
+    {
+        trackedExprs.resize(num);
+        trackedLabels.resize(num);
+    }
+    /// Describe the loads (selects) of e and the stores of the memory they read
+    void getMemSites(const z3::expr &e, std::vector<std::string> &sites) const;
+    std::string describeAddr(const z3::expr &addr) const;
+    /// Print the unsat core of the tracked constraints, if any, before aborting on unsatisfiable constraints
+    void reportUnsat();
+    ///@}
+
+    /// Constant propagation helpers
+    ///@{
+    bool propagateConstraint(z3::expr &e);
+    /// Return the folded query if substitutions are known, otherwise e itself
+    inline z3::expr foldQuery(const z3::expr &e)
+    {
+        return constProp.fold(e);
+    }
+    ///@}
+
+    ChunkedExprMap varID2ExprMap;    /// var to z3 expression
+    Z3Memory<Encoding> memory;       /// loc2ValMap and the state of the memory models
+    z3::model cachedModel;  /// model returned by the last solver check
+    u32_t solverGen;        /// bumped whenever the solver's constraints or scopes change
+    u32_t modelGen;         /// the solverGen that cachedModel was computed for
+    Z3CheckStatus modelStatus;  /// status of the check of the last (cached or sliced) model
+    /// An address proved (or refuted) unique for its model value; holding loc keeps Z3 from reusing its AST id
+    struct UniqueAddr
+    {
+        z3::expr loc;
+        z3::expr addr;
+        bool unique;
+    };
+    std::unordered_map<unsigned, UniqueAddr> uniqueAddrs;  /// AST id of an address -> whether it is unique
+    u32_t uniqueAddrsGen;       /// the solverGen that uniqueAddrs was computed for
+    bool shadowMem;              /// whether the concrete shadow memory is used
+    z3::expr_vector guardPool;   /// assertion indicators: the i-th assertion of every batch is guarded by guardPool[i]
+    z3::expr_vector constraints;            /// constraints added through addToSolver, in order
+    std::vector<u32_t> constraintScopes;    /// number of constraints when each scope was pushed
+    Z3Slicer slicer;                        /// the cone-of-influence index of the constraints (if slicing)
+    /// A variable's constant and its SVFVar ID; holding the constant keeps Z3 from reusing its AST id
+    struct DeclaredVar
+    {
+        z3::expr var;
+        u32_t idx;
+    };
+    std::unordered_map<unsigned, DeclaredVar> astID2VarID;  /// AST id of a variable's constant -> its SVFVar ID
+    MemModel memModel;                      /// the memory model of storeValue/loadValue
+    Z3SolverConfig solverConfig;                    /// how solvers are created and checked
+    Z3CachedQueries queryCache;                     /// results of previous queries, keyed over the constraint log
+    Z3ConstantPropagation constProp;                /// the substitutions of constant propagation (if enabled)
+    bool coreTracking;                              /// whether the constraints are recorded for unsat cores
+    z3::expr_vector trackedExprs;                   /// the tracked constraints, as given to addToSolver
+    std::vector<std::string> trackedLabels;         /// trackedLabels[i]: the label of trackedExprs[i]
+    std::vector<u32_t> trackedScopes;               /// number of tracked constraints when each scope was pushed
+    std::unique_ptr<Z3IntervalDomain> intervals;    /// the interval pre-analysis (null if disabled)
+    IntervalStats intervalStats;                    /// assertions decided by the interval pre-analysis
+
+    bool instrumented;                              /// whether the operations are recorded in Z3Instrumentation
+    Z3StoreDepths storeDepths;                      /// store depths of the memories recorded in Z3Instrumentation
+    Z3Trace trace;                                  /// the SMT-LIB2 trace of the session (if recording)
+
+    static const u32_t DefaultQueryCacheCapacity = 1 << 16;
+    static const u32_t DefaultCoreBudgetMs = 1000;  /// minimisation budget of the core reported on unsat constraints
+    static const u32_t DefaultFreshAfter = 1 << 12; /// constraints after which resetSession resets the solver
+
+    bool lightReset;            /// whether sessions are reset through the base scope
+    u32_t freshAfter;           /// constraints after which resetSession resets the solver
+    u32_t sessionConstraints;   /// constraints of the sessions since the solver was last reset
 };
 
+/// The Z3 manager with the encoding selected at compile time (Z3MGR_ENCODING_BV32/Z3MGR_ENCODING_BV64, Int by default)
+typedef GenericZ3Mgr<DefaultEncoding> Z3Mgr;
+
 
-class Z3Tests : public Z3Mgr
+template<class Encoding>
+class GenericZ3Tests : public GenericZ3Mgr<Encoding>
 {
 public:
-    Z3Tests(u32_t max = 128)
-            : Z3Mgr(max), maxNumOfExpr(max), currentExprIdx(0)
+    typedef GenericZ3Mgr<Encoding> Z3Mgr;
+    using Z3Mgr::ctx;
+    using Z3Mgr::solver;
+    using Z3Mgr::addToSolver;
+    using Z3Mgr::storeValue;
+    using Z3Mgr::loadValue;
+    using Z3Mgr::getEvalExpr;
+    using Z3Mgr::getEvalValues;
+    using Z3Mgr::getInternalID;
+    using Z3Mgr::getVarID;
+    using Z3Mgr::addMemObj;
+    using Z3Mgr::addGepObj;
+    using Z3Mgr::getMemModel;
+    using Z3Mgr::resetSolverState;
+    using Z3Mgr::clearVarID2ExprMap;
+    using Z3Mgr::isLightweightReset;
+
+    /// Field objects are numbered upwards from GepObjTag in the order they are first used; named variables are
+    /// numbered below it, so the two ranges never meet
+    static const u32_t GepObjTag = 1 << 23;
+
+    GenericZ3Tests() : Z3Mgr(), currentExprIdx(0)
     {}
 
+    /// With lightweight resets, the declared expression of a named variable is restored at the next resetSolver,
+    /// e.g., after getMemObjAddress made it an address
+    inline void updateZ3Expr(u32_t idx, z3::expr target)
+    {
+        if (isLightweightReset() && Z3Mgr::hasZ3Expr(idx))
+            overwrittenExprs.emplace_back(idx, Z3Mgr::getZ3Expr(idx));
+        Z3Mgr::updateZ3Expr(idx, target);
+    }
+
     // Return an z3 expr given an id
     inline z3::expr getZ3Expr(u32_t val)
     {
-        return ctx.int_val(val);
+        return Encoding::getVal(ctx, val);
     }
 
+    using Z3Mgr::hasZ3Expr;
+
     // Return true if strToIDMap has this expression name
-    inline bool hasZ3Expr(std::string exprName)
+    inline bool hasZ3Expr(const std::string &exprName)
     {
         return strToIDMap.find(exprName) != strToIDMap.end();
     }
 
     // Return an z3 expr given a string name
-    inline z3::expr getZ3Expr(std::string exprName)
+    inline z3::expr getZ3Expr(const std::string &exprName)
     {
-        auto it = strToIDMap.find(exprName);
-        if (it != strToIDMap.end())
-            return Z3Mgr::getZ3Expr(it->second);
-        else
-        {
-            strToIDMap[exprName] = ++currentExprIdx;
-            assert(maxNumOfExpr >= currentExprIdx && "creating more expression than upper limit");
-            z3::expr e = ctx.int_const(exprName.c_str());
-            updateZ3Expr(currentExprIdx, e);
-            return e;
-        }
+        return Z3Mgr::getZ3Expr(getExprID(exprName));
     }
 
     // Return an z3 expr for an object given a string name
-    inline z3::expr getMemObjAddress(std::string exprName)
+    inline z3::expr getMemObjAddress(const std::string &exprName)
     {
-        z3::expr e = getZ3Expr(exprName);
-        auto iter = strToIDMap.find(exprName);
-        assert(iter != strToIDMap.end() && "address expr not found?");
-        e = getZ3Expr(Z3Mgr::getVirtualMemAddress(iter->second));
-        updateZ3Expr(iter->second, e);
+        u32_t id = getExprID(exprName);
+        z3::expr e = getZ3Expr(Z3Mgr::getVirtualMemAddress(id));
+        updateZ3Expr(id, e);
+        addMemObj(id);
         return e;
     }
 
     // Return a field object or array element object given a base pointer and an offset
+    // The base pointer is resolved by the AST id of its constant, i.e., without building its name
     inline z3::expr getGepObjAddress(z3::expr pointer, u32_t offset)
     {
-        std::string baseObjName = pointer.to_string();
-        auto iter = strToIDMap.find(baseObjName);
-        assert(iter != strToIDMap.end() && "Gep BaseObject expr not found?");
-        u32_t baseObjID = iter->second;
-        u32_t gepObj = baseObjID + offset;
-        if (baseObjID == gepObj)
+        u32_t baseObjID;
+        if (!getVarID(pointer, baseObjID))
         {
-            return pointer;
+            assert(false && "Gep BaseObject expr not found?");
+            abort();
         }
-        else
+        if (offset == 0)
+            return pointer;
+
+        // field objects have their own id range
+        u32_t nextGepObj = GepObjTag + gepObjIDMap.size();
+        assert(nextGepObj < AddressMask && "too many field objects");
+        u32_t gepObj = gepObjIDMap.emplace(((uint64_t) baseObjID << 32) | offset, nextGepObj).first->second;
+        z3::expr e = getZ3Expr(Z3Mgr::getVirtualMemAddress(gepObj));
+        updateZ3Expr(gepObj, e);
+        if (getMemModel() != Z3Mgr::ArrayMem)
         {
-            gepObj += maxNumOfExpr / 2; // gep obj ID starts from maxNumOfExpr/2 in this lab exercise
-            z3::expr e = getZ3Expr(Z3Mgr::getVirtualMemAddress(gepObj));
-            updateZ3Expr(gepObj, e);
-            return e;
+            // group the field with the object the base pointer targets (the pointer itself if unknown)
+            int64_t baseAddr;
+            bool known = Encoding::getNumValue(getEvalExpr(pointer), baseAddr);
+            addGepObj(gepObj, known ? getInternalID(baseAddr) : baseObjID, offset);
         }
-    }
-
-    // Add an z3 expression into solver for later satisfiability solving
-    void addToSolver(z3::expr e)
-    {
-        solver.add(e);
+        return e;
     }
 
     // Reset solver's stack and clear up the maps
+    // With lightweight resets, only the session is reset: the name table and the declared variables are kept
     void resetSolver()
     {
-        solver.reset();
+        if (isLightweightReset())
+        {
+            Z3Mgr::resetSession();
+            for (auto it = overwrittenExprs.rbegin(); it != overwrittenExprs.rend(); ++it)
+                Z3Mgr::updateZ3Expr(it->first, it->second);
+            overwrittenExprs.clear();
+            sessionIDs.clear();
+            return;
+        }
+        resetSolverState();
         strToIDMap.clear();
+        gepObjIDMap.clear();
         currentExprIdx = 0;
         clearVarID2ExprMap();
     }
@@ -245,16 +1350,28 @@ public:
     /// Print out all expressions' values after evaluation
     void printExprValues()
     {
+        // print in the order of names
+        std::vector<std::pair<std::string, u32_t>> names;
+        for (const auto &name : strToIDMap)
+        {
+            if (!isLightweightReset() || sessionIDs.count(name.second))
+                names.push_back(name);
+        }
+        std::sort(names.begin(), names.end());
+        z3::expr_vector es(ctx);
+        for (const auto &name : names)
+            es.push_back(Z3Mgr::getZ3Expr(name.second));
+        EvalValues vals = getEvalValues(es);
+
         std::cout.flags(std::ios::left);
         std::cout << "-----------Var and Value-----------\n";
-        for (auto nIter = strToIDMap.begin(); nIter != strToIDMap.end(); nIter++)
+        for (u32_t i = 0; i < names.size(); i++)
         {
-            z3::expr e = Z3Mgr::getEvalExpr(Z3Mgr::getZ3Expr(nIter->second));
-            if (e.is_numeral())
+            if (vals.isNumeral[i])
             {
-                s32_t value = e.get_numeral_int64();
+                s32_t value = vals.values[i];
                 std::stringstream exprName;
-                exprName << "Var" << nIter->second << " (" << nIter->first << ")";
+                exprName << "Var" << names[i].second << " (" << names[i].first << ")";
                 std::cout << std::setw(25) << exprName.str();
                 if (Z3Mgr::isVirtualMemAddress(value))
                     std::cout << "\t Value: " << std::hex << "0x" << value << "\n";
@@ -281,11 +1398,30 @@ public:
     ///@}
 
 private:
-    std::map<std::string, u32_t> strToIDMap;    /// map a string name to its corresponding id (only used in Lab-Exercise-2)
-    u32_t maxNumOfExpr;
+    /// Return the id of a name, creating a new variable for an unseen name
+    inline u32_t getExprID(const std::string &exprName)
+    {
+        auto it = strToIDMap.emplace(exprName, currentExprIdx + 1);
+        if (it.second)
+        {
+            assert(currentExprIdx + 1 < GepObjTag && "named variables overflow into the field object ids");
+            it.first->second = ++currentExprIdx;
+            updateZ3Expr(currentExprIdx, ctx.constant(exprName.c_str(), Encoding::getSort(ctx)));
+        }
+        if (isLightweightReset())
+            sessionIDs.insert(it.first->second);
+        return it.first->second;
+    }
+
+    std::unordered_map<std::string, u32_t> strToIDMap;    /// map a string name to its corresponding id (only used in Lab-Exercise-2)
+    std::unordered_map<uint64_t, u32_t> gepObjIDMap;    /// (base id, offset) -> field object id
     u32_t currentExprIdx;
+    std::vector<std::pair<u32_t, z3::expr>> overwrittenExprs;  /// (id, previous expression) updated in this session
+    std::unordered_set<u32_t> sessionIDs;                       /// ids of the names used in this session
 };
 
+typedef GenericZ3Tests<DefaultEncoding> Z3Tests;
+
 } // namespace SVF
 
 #endif //ANSWERS_DEV_Z3MGR_H
@@ -0,0 +1,123 @@
+/**
+ * Z3MgrPool.cpp
+ * A pool of worker threads, each owning a GenericZ3Mgr, for solving independent queries in parallel.
+ */
+
+#include "Z3MgrPool.h"
+
+using namespace SVF;
+
+template<class Encoding>
+GenericZ3MgrPool<Encoding>::Snapshot::Snapshot(GenericZ3MgrPool &p, const z3::expr_vector &es) : pool(p)
+{
+    std::lock_guard<std::mutex> lock(pool.transferMutex);
+    id = ++pool.snapshotCounter;
+    exprs.reset(new z3::expr_vector(pool.transferCtx, es));
+}
+
+/// The expressions are released under the transfer mutex, as a worker may be translating other snapshots
+template<class Encoding>
+GenericZ3MgrPool<Encoding>::Snapshot::~Snapshot()
+{
+    std::lock_guard<std::mutex> lock(pool.transferMutex);
+    exprs.reset();
+}
+
+/// The managers are created upfront so that every worker has one before any job runs
+template<class Encoding>
+GenericZ3MgrPool<Encoding>::GenericZ3MgrPool(u32_t numThreads) : stopping(false), snapshotCounter(0)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (u32_t i = 0; i < numThreads; i++)
+        mgrs.emplace_back(new Z3Mgr());
+    loadedSnapshots.resize(numThreads, 0);
+    for (u32_t i = 0; i < numThreads; i++)
+        workers.emplace_back(&GenericZ3MgrPool::runWorker, this, i);
+}
+
+template<class Encoding>
+GenericZ3MgrPool<Encoding>::~GenericZ3MgrPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCV.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+template<class Encoding>
+void GenericZ3MgrPool<Encoding>::enqueue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        assert(!stopping && "submit to a stopped pool?");
+        jobs.push_back(std::move(job));
+    }
+    queueCV.notify_one();
+}
+
+/// Run queued jobs until the pool is stopped and the queue is drained
+template<class Encoding>
+void GenericZ3MgrPool<Encoding>::runWorker(u32_t worker)
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCV.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job(worker);
+    }
+}
+
+template<class Encoding>
+z3::expr_vector GenericZ3MgrPool<Encoding>::restore(const Snapshot &snap, Z3Mgr &mgr)
+{
+    assert(&snap.pool == this && "snapshot of another pool?");
+    std::lock_guard<std::mutex> lock(transferMutex);
+    return z3::expr_vector(mgr.getCtx(), *snap.exprs);
+}
+
+/// The constraints are snapshotted once for the whole batch; every job restores its own assertion
+template<class Encoding>
+std::vector<std::future<AssertCheckResult>> GenericZ3MgrPool<Encoding>::checkNegateAssertsAsync(Z3Mgr &src, const z3::expr_vector &qs)
+{
+    SnapshotPtr cons = snapshot(src.getConstraints());
+    std::vector<std::future<AssertCheckResult>> results;
+    results.reserve(qs.size());
+    for (u32_t i = 0; i < qs.size(); i++)
+    {
+        z3::expr_vector q(src.getCtx());
+        q.push_back(qs[i]);
+        SnapshotPtr query = snapshot(q);
+        std::packaged_task<AssertCheckResult(u32_t)> task([this, cons, query](u32_t worker)
+        {
+            Z3Mgr &mgr = *mgrs[worker];
+            if (loadedSnapshots[worker] != cons->getID())
+            {
+                mgr.resetSolverState();
+                z3::expr_vector es = restore(*cons, mgr);
+                for (u32_t j = 0; j < es.size(); j++)
+                    mgr.addToSolver(es[j]);
+                loadedSnapshots[worker] = cons->getID();
+            }
+            return mgr.checkNegateAsserts(restore(*query, mgr))[0];
+        });
+        results.push_back(task.get_future());
+        auto shared = std::make_shared<std::packaged_task<AssertCheckResult(u32_t)>>(std::move(task));
+        enqueue([shared](u32_t worker) { (*shared)(worker); });
+    }
+    return results;
+}
+
+template class SVF::GenericZ3MgrPool<IntEncoding>;
+template class SVF::GenericZ3MgrPool<BV32Encoding>;
+template class SVF::GenericZ3MgrPool<BV64Encoding>;
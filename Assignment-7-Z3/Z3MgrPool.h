@@ -0,0 +1,125 @@
+/**
+ * Z3MgrPool.h
+ * A pool of worker threads, each owning a GenericZ3Mgr (and thus its own z3::context),
+ * for solving independent queries in parallel.
+ */
+
+#ifndef ANSWERS_DEV_Z3MGRPOOL_H
+#define ANSWERS_DEV_Z3MGRPOOL_H
+
+#include "Z3Mgr.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace SVF
+{
+
+/// Z3 contexts are not thread-safe: a context, and every expression of it, must only be used by one thread at a
+/// time. Each worker of the pool therefore owns its manager, and expressions of the caller's context reach a worker
+/// in two translation steps: the caller translates them into the pool's transfer context (snapshot), and the worker
+/// translates them from there into its own context (restore). Both steps hold the transfer mutex, so the caller's
+/// context is only touched by the caller's thread and each worker's context only by its worker.
+template<class Encoding>
+class GenericZ3MgrPool
+{
+public:
+    typedef GenericZ3Mgr<Encoding> Z3Mgr;
+
+    /// Expressions of a caller's context, kept in the transfer context until every job using them is done
+    class Snapshot
+    {
+    public:
+        Snapshot(GenericZ3MgrPool &p, const z3::expr_vector &es);
+        ~Snapshot();
+
+        inline u32_t getID() const
+        {
+            return id;
+        }
+
+        inline u32_t size() const
+        {
+            return exprs->size();
+        }
+
+    private:
+        friend class GenericZ3MgrPool;
+        GenericZ3MgrPool &pool;
+        u32_t id;
+        std::unique_ptr<z3::expr_vector> exprs;
+    };
+    typedef std::shared_ptr<Snapshot> SnapshotPtr;
+
+    /// Start numThreads workers (the number of hardware threads by default)
+    GenericZ3MgrPool(u32_t numThreads = 0);
+
+    /// Finish the queued jobs and join the workers
+    ~GenericZ3MgrPool();
+
+    inline u32_t getNumThreads() const
+    {
+        return workers.size();
+    }
+
+    /// Queue a job; it runs on some worker with that worker's manager.
+    /// Expressions of other contexts must reach the job through a snapshot (see restore).
+    template<class F>
+    auto submit(F job) -> std::future<decltype(job(std::declval<Z3Mgr &>()))>
+    {
+        typedef decltype(job(std::declval<Z3Mgr &>())) Result;
+        auto task = std::make_shared<std::packaged_task<Result(Z3Mgr &)>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        enqueue([this, task](u32_t worker)
+        {
+            // the job may change the solver, so the worker no longer holds the constraints of a snapshot
+            loadedSnapshots[worker] = 0;
+            (*task)(*mgrs[worker]);
+        });
+        return result;
+    }
+
+    /// Copy expressions of the calling thread's context into the pool (called by the owner of that context).
+    /// The pool must outlive its snapshots.
+    inline SnapshotPtr snapshot(const z3::expr_vector &es)
+    {
+        return std::make_shared<Snapshot>(*this, es);
+    }
+
+    /// Translate the expressions of a snapshot into the given worker's context (called by that worker's job)
+    z3::expr_vector restore(const Snapshot &snap, Z3Mgr &mgr);
+
+    /// Check each assertion of qs under the constraints of src in parallel, one job per assertion.
+    /// Workers keep the constraints of the last snapshot they loaded, so the jobs of one batch that land on the
+    /// same worker only add the constraints once. The results have no counterexample models.
+    std::vector<std::future<AssertCheckResult>> checkNegateAssertsAsync(Z3Mgr &src, const z3::expr_vector &qs);
+
+private:
+    /// A queued job, called with the index of the worker running it
+    typedef std::function<void(u32_t)> Job;
+
+    void enqueue(Job job);
+    void runWorker(u32_t worker);
+
+    std::deque<Job> jobs;
+    std::mutex queueMutex;
+    std::condition_variable queueCV;
+    bool stopping;
+
+    z3::context transferCtx;    /// holds the expressions of live snapshots
+    std::mutex transferMutex;   /// guards transferCtx and all translations from/into it
+    u32_t snapshotCounter;      /// snapshot ids start from 1
+
+    std::vector<std::unique_ptr<Z3Mgr>> mgrs;   /// the manager of each worker (only used by that worker)
+    std::vector<u32_t> loadedSnapshots;         /// the snapshot whose constraints each worker's solver holds (0: none)
+    std::vector<std::thread> workers;
+};
+
+typedef GenericZ3MgrPool<DefaultEncoding> Z3MgrPool;
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3MGRPOOL_H
@@ -0,0 +1,223 @@
+/**
+ * Z3QueryCache.cpp
+ * An LRU cache of the results of GenericZ3Mgr queries, keyed by structural hashes of the constraints and the query.
+ */
+
+#include "Z3QueryCache.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+using namespace SVF;
+
+Z3QueryCache::Z3QueryCache(uint32_t cap, const std::string &f) : capacity(cap), file(f), hits(0), misses(0)
+{
+    assert(capacity > 0 && "empty query cache?");
+    load();
+}
+
+Z3QueryCache::~Z3QueryCache()
+{
+    save();
+}
+
+bool Z3QueryCache::lookup(uint64_t key, Entry &entry)
+{
+    auto it = index.find(key);
+    if (it == index.end())
+    {
+        misses++;
+        return false;
+    }
+    hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    entry = it->second->second;
+    return true;
+}
+
+void Z3QueryCache::insert(uint64_t key, const Entry &entry)
+{
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        it->second->second = entry;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+    if (lru.size() >= capacity)
+    {
+        index.erase(lru.back().first);
+        lru.pop_back();
+    }
+    lru.emplace_front(key, entry);
+    index[key] = lru.begin();
+}
+
+/// One entry per line: "<key in hex> <kind> <value>"
+void Z3QueryCache::read(const std::string &file, std::vector<std::pair<uint64_t, Entry>> &entries)
+{
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        uint64_t key;
+        char kind;
+        Entry entry;
+        if (!(fields >> std::hex >> key >> kind >> std::dec >> entry.value))
+            continue;
+        if (kind != Entry::Numeral && kind != Entry::Bool && kind != Entry::Sat && kind != Entry::Unsat)
+            continue;
+        entry.kind = (Entry::Kind) kind;
+        entries.emplace_back(key, entry);
+    }
+}
+
+void Z3QueryCache::load()
+{
+    if (file.empty())
+        return;
+    std::vector<std::pair<uint64_t, Entry>> entries;
+    read(file, entries);
+    for (const auto &entry : entries)
+        insert(entry.first, entry.second);
+}
+
+/// The entries of the file that this cache does not hold are written first, as the least recently used ones,
+/// and the oldest of them are dropped beyond the capacity
+void Z3QueryCache::save() const
+{
+    if (file.empty())
+        return;
+    static std::mutex saveMutex;
+    std::lock_guard<std::mutex> lock(saveMutex);
+
+    std::vector<std::pair<uint64_t, Entry>> onDisk, others;
+    read(file, onDisk);
+    for (const auto &entry : onDisk)
+    {
+        if (!index.count(entry.first))
+            others.push_back(entry);
+    }
+    size_t skip = others.size() + lru.size() > capacity ? others.size() + lru.size() - capacity : 0;
+
+    std::string tmpFile = file + ".tmp";
+    {
+        std::ofstream out(tmpFile, std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "cannot write the query cache to " << file << "\n";
+            return;
+        }
+        for (size_t i = std::min(skip, others.size()); i < others.size(); i++)
+            out << std::hex << others[i].first << " " << (char) others[i].second.kind << " " << std::dec
+                << others[i].second.value << "\n";
+        for (auto it = lru.rbegin(); it != lru.rend(); ++it)
+            out << std::hex << it->first << " " << (char) it->second.kind << " " << std::dec << it->second.value << "\n";
+    }
+    if (std::rename(tmpFile.c_str(), file.c_str()) != 0)
+    {
+        std::cerr << "cannot write the query cache to " << file << "\n";
+        std::remove(tmpFile.c_str());
+    }
+}
+
+/// FNV-1a, which (unlike std::hash) is stable across runs and platforms
+static uint64_t hashString(const std::string &str)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : str)
+        h = (h ^ c) * 0x100000001b3ULL;
+    return h;
+}
+
+static uint64_t hashSort(const z3::sort &s)
+{
+    uint64_t h = Z3QueryCache::mix(s.sort_kind());
+    if (s.is_bv())
+        h = Z3QueryCache::combine(h, s.bv_size());
+    else if (s.is_array())
+        h = Z3QueryCache::combine(Z3QueryCache::combine(h, hashSort(s.array_domain())), hashSort(s.array_range()));
+    return h;
+}
+
+uint64_t Z3QueryCache::hashExpr(const z3::expr &e, std::unordered_map<unsigned, uint64_t> &memo)
+{
+    auto it = memo.find(e.id());
+    if (it != memo.end())
+        return it->second;
+
+    uint64_t h = hashSort(e.get_sort());
+    if (e.is_numeral())
+        h = Z3QueryCache::combine(h, hashString(Z3_get_numeral_string(e.ctx(), e)));
+    else if (e.is_app())
+    {
+        z3::func_decl decl = e.decl();
+        h = Z3QueryCache::combine(h, decl.decl_kind());
+        if (decl.decl_kind() == Z3_OP_UNINTERPRETED)
+            h = Z3QueryCache::combine(h, hashString(decl.name().str()));
+        // indexed operators, e.g., extract and sign_ext of bit-vectors
+        for (unsigned i = 0; i < Z3_get_decl_num_parameters(e.ctx(), decl); i++)
+            if (Z3_get_decl_parameter_kind(e.ctx(), decl, i) == Z3_PARAMETER_INT)
+                h = Z3QueryCache::combine(h, Z3_get_decl_int_parameter(e.ctx(), decl, i));
+        h = Z3QueryCache::combine(h, e.num_args());
+        for (unsigned i = 0; i < e.num_args(); i++)
+            h = Z3QueryCache::combine(h, hashExpr(e.arg(i), memo));
+    }
+    else if (e.is_var())
+        h = Z3QueryCache::combine(h, Z3_get_index_value(e.ctx(), e));
+    else
+        h = Z3QueryCache::combine(h, hashString(e.to_string()));
+    memo.emplace(e.id(), h);
+    return h;
+}
+
+/// Shared sub-expressions are hashed once
+uint64_t Z3QueryCache::hashExpr(const z3::expr &e)
+{
+    std::unordered_map<unsigned, uint64_t> memo;
+    return hashExpr(e, memo);
+}
+
+void Z3CachedQueries::enable(uint32_t capacity, const std::string &file)
+{
+    if (capacity == 0)
+        cache.reset();
+    else
+        cache.reset(new Z3QueryCache(capacity, file));
+}
+
+/// The hash of a set is the sum of the mixed hashes of its constraints, so it does not depend on the
+/// order the constraints were added in and can be extended (and truncated) along the constraint log.
+/// The constraints share long store chains over loc2ValMap, so their sub-expression hashes are memoized.
+uint64_t Z3CachedQueries::getConstraintSetHash(const z3::expr_vector &constraints)
+{
+    while (setHashes.size() < constraints.size())
+    {
+        uint64_t prev = setHashes.empty() ? 0 : setHashes.back();
+        uint64_t h = Z3QueryCache::mix(Z3QueryCache::hashExpr(constraints[setHashes.size()], memo));
+        setHashes.push_back(prev + h);
+    }
+    return constraints.empty() ? 0 : setHashes[constraints.size() - 1];
+}
+
+/// The memo is keyed by AST ids, which the dropped constraints may no longer hold alive
+void Z3CachedQueries::truncate(uint32_t num)
+{
+    if (setHashes.size() > num)
+    {
+        setHashes.resize(num);
+        memo.clear();
+    }
+}
+
+void Z3CachedQueries::insertVerdict(uint64_t key, bool holds)
+{
+    Z3QueryCache::Entry entry;
+    entry.kind = holds ? Z3QueryCache::Entry::Unsat : Z3QueryCache::Entry::Sat;
+    entry.value = 0;
+    cache->insert(key, entry);
+}
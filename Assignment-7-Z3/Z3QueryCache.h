@@ -0,0 +1,180 @@
+/**
+ * Z3QueryCache.h
+ * An LRU cache of the results of GenericZ3Mgr queries, keyed by structural hashes of the constraints and the query.
+ */
+
+#ifndef ANSWERS_DEV_Z3QUERYCACHE_H
+#define ANSWERS_DEV_Z3QUERYCACHE_H
+
+#include "z3++.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SVF
+{
+
+/// An LRU cache of query results keyed by structural hashes.
+/// A hash only depends on the structure of an expression (operators, symbol names, numerals and sorts),
+/// not on AST ids, so results can be reused across contexts and, through an optional file, across runs.
+class Z3QueryCache
+{
+public:
+    /// A cached result: the value of an evaluated expression or the verdict of an assertion check
+    struct Entry
+    {
+        enum Kind : char
+        {
+            Numeral = 'n',  ///< value is the numeral
+            Bool = 'b',     ///< value is 0 (false) or 1 (true)
+            Sat = 's',      ///< the negated assertion is satisfiable, i.e., there is a counterexample
+            Unsat = 'u'     ///< the assertion holds
+        };
+        Kind kind;
+        int64_t value;
+    };
+
+    /// The entries in file (if any) are loaded, and the cache is merged back into it on destruction
+    Z3QueryCache(uint32_t capacity, const std::string &file);
+    ~Z3QueryCache();
+
+    /// Look up a key and mark it as most recently used
+    bool lookup(uint64_t key, Entry &entry);
+
+    /// Insert or overwrite an entry, evicting the least recently used one if the cache is full
+    void insert(uint64_t key, const Entry &entry);
+
+    /// Merge the entries into the file (least recently used first); no-op without a file.
+    /// The entries other caches saved to the file since it was loaded are kept (ours win on conflicts), up to
+    /// the capacity. Saves are serialized, and the file is replaced atomically, so managers sharing a file
+    /// (e.g., the workers of a Z3MgrPool) neither lose each other's entries nor see a partial file
+    void save() const;
+
+    inline uint32_t getHits() const
+    {
+        return hits;
+    }
+    inline uint32_t getMisses() const
+    {
+        return misses;
+    }
+
+    /// Structural hash of an expression
+    static uint64_t hashExpr(const z3::expr &e);
+
+    /// Structural hash of an expression, reusing (and extending) the hashes of sub-expressions in memo.
+    /// memo is keyed by AST ids, so it must be cleared once any of its expressions may have been freed.
+    static uint64_t hashExpr(const z3::expr &e, std::unordered_map<unsigned, uint64_t> &memo);
+
+    /// Mix a value into a hash
+    static inline uint64_t combine(uint64_t h, uint64_t v)
+    {
+        return mix(h ^ (mix(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    }
+
+    /// splitmix64 finalizer
+    static inline uint64_t mix(uint64_t h)
+    {
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+
+private:
+    typedef std::list<std::pair<uint64_t, Entry>> LRUList;
+
+    /// Read the entries of the file, least recently used first; malformed lines are skipped
+    static void read(const std::string &file, std::vector<std::pair<uint64_t, Entry>> &entries);
+    void load();
+
+    uint32_t capacity;
+    std::string file;
+    LRUList lru;    /// most recently used first
+    std::unordered_map<uint64_t, LRUList::iterator> index;
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/// The query cache of a GenericZ3Mgr: the cache (if enabled) and the structural hashes of the manager's constraint
+/// log, from which the keys of its queries are built
+class Z3CachedQueries
+{
+public:
+    /// Enable the cache with the given capacity, loaded from and saved to file if not empty (0 disables it)
+    void enable(uint32_t capacity, const std::string &file);
+
+    inline bool isEnabled() const
+    {
+        return cache != nullptr;
+    }
+
+    inline Z3QueryCache *getCache() const
+    {
+        return cache.get();
+    }
+
+    /// Order-insensitive hash of constraints, the constraint log of the manager: it only grows, or is truncated
+    /// through truncate
+    uint64_t getConstraintSetHash(const z3::expr_vector &constraints);
+
+    /// Cache key of evaluating e (or of checking assertion e if isAssert) under constraints
+    inline uint64_t getKey(const z3::expr_vector &constraints, const z3::expr &e, bool isAssert)
+    {
+        return Z3QueryCache::combine(Z3QueryCache::combine(getConstraintSetHash(constraints),
+                                                           Z3QueryCache::hashExpr(e)), isAssert);
+    }
+
+    /// The constraint log was truncated to its first num constraints
+    void truncate(uint32_t num);
+
+    inline bool lookup(uint64_t key, Z3QueryCache::Entry &entry)
+    {
+        return cache->lookup(key, entry);
+    }
+
+    /// Look up the value of an evaluated expression, rebuilt in ctx with Encoding
+    template<class Encoding>
+    bool lookupValue(uint64_t key, z3::context &ctx, z3::expr &val)
+    {
+        Z3QueryCache::Entry entry;
+        if (!cache->lookup(key, entry))
+            return false;
+        if (entry.kind == Z3QueryCache::Entry::Numeral)
+            val = Encoding::getVal(ctx, entry.value);
+        else
+            val = ctx.bool_val(entry.value != 0);
+        return true;
+    }
+
+    /// Only numerals and Boolean constants are cached, as they can be rebuilt in any context
+    template<class Encoding>
+    void insertValue(uint64_t key, const z3::expr &val)
+    {
+        Z3QueryCache::Entry entry;
+        if (Encoding::getNumValue(val, entry.value))
+            entry.kind = Z3QueryCache::Entry::Numeral;
+        else if (val.is_true() || val.is_false())
+        {
+            entry.kind = Z3QueryCache::Entry::Bool;
+            entry.value = val.is_true();
+        }
+        else
+            return;
+        cache->insert(key, entry);
+    }
+
+    /// Record the verdict of checking an assertion
+    void insertVerdict(uint64_t key, bool holds);
+
+private:
+    std::unique_ptr<Z3QueryCache> cache;        /// results of previous queries (null if disabled)
+    std::vector<uint64_t> setHashes;            /// [i]: hash of the constraint set constraints[0..i]
+    std::unordered_map<unsigned, uint64_t> memo;    /// AST id -> hash of sub-expressions of constraints
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3QUERYCACHE_H
@@ -0,0 +1,154 @@
+/**
+ * Z3Replay.cpp
+ * Re-run an SMT-LIB2 trace recorded by GenericZ3Mgr::setTrace (or the environment variable Z3MGR_TRACE)
+ * and report the result and time of every check, next to the ones recorded in the trace.
+ *
+ * Usage: z3replay <trace.smt2> [timeoutMs]
+ */
+
+#include "z3++.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// A command of the trace and the comment following it (the recorded result of a check)
+struct TraceCommand
+{
+    std::string text;
+    std::string comment;
+    unsigned line;
+};
+
+/// Split a script into top-level commands, skipping comments, strings and quoted symbols
+static std::vector<TraceCommand> parseTrace(const std::string &script)
+{
+    std::vector<TraceCommand> cmds;
+    unsigned line = 1;
+    size_t i = 0;
+    while (i < script.size())
+    {
+        char c = script[i];
+        if (c == '\n')
+            line++;
+        if (c == ';')
+        {
+            size_t end = script.find('\n', i);
+            if (end == std::string::npos)
+                end = script.size();
+            if (!cmds.empty() && cmds.back().comment.empty())
+                cmds.back().comment = script.substr(i + 1, end - i - 1);
+            i = end;
+            continue;
+        }
+        if (c != '(')
+        {
+            i++;
+            continue;
+        }
+        TraceCommand cmd;
+        cmd.line = line;
+        size_t start = i;
+        int depth = 0;
+        for (; i < script.size(); i++)
+        {
+            c = script[i];
+            if (c == '\n')
+                line++;
+            else if (c == '|' || c == '"')
+            {
+                size_t end = script.find(c, i + 1);
+                if (end == std::string::npos)
+                    end = script.size() - 1;
+                for (size_t j = i; j < end; j++)
+                    line += script[j] == '\n';
+                i = end;
+            }
+            else if (c == '(')
+                depth++;
+            else if (c == ')' && --depth == 0)
+                break;
+        }
+        cmd.text = script.substr(start, i + 1 - start);
+        cmds.push_back(cmd);
+        i++;
+    }
+    return cmds;
+}
+
+static bool isCheck(const std::string &cmd)
+{
+    return cmd.compare(0, 10, "(check-sat") == 0;
+}
+
+static std::string trim(const std::string &s)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace.smt2> [timeoutMs]\n";
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in)
+    {
+        std::cerr << "cannot read " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream script;
+    script << in.rdbuf();
+    if (argc > 2)
+        z3::set_param("timeout", argv[2]);
+
+    std::vector<TraceCommand> cmds = parseTrace(script.str());
+    z3::context ctx;
+    std::cout << "Z3 " << Z3_get_full_version() << ", " << cmds.size() << " commands\n";
+    std::cout.flags(std::ios::left);
+    std::cout << std::setw(8) << "check" << std::setw(8) << "line" << std::setw(10) << "result" << std::setw(14)
+              << "time (ms)" << "recorded\n";
+
+    unsigned numChecks = 0, numMismatches = 0, numErrors = 0;
+    double totalMs = 0, recordedMs = 0;
+    for (const TraceCommand &cmd : cmds)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string out = trim(Z3_eval_smtlib2_string(ctx, cmd.text.c_str()));
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (out.compare(0, 6, "(error") == 0)
+        {
+            numErrors++;
+            std::cerr << "line " << cmd.line << ": " << out << "\n";
+        }
+        if (!isCheck(cmd.text))
+            continue;
+
+        numChecks++;
+        totalMs += elapsed.count();
+        // the recorded comment is "<result> <time> ms"
+        std::string recordedRes;
+        double recordedTime = 0;
+        std::istringstream recorded(cmd.comment);
+        bool hasRecord = static_cast<bool>(recorded >> recordedRes >> recordedTime);
+        if (hasRecord)
+        {
+            recordedMs += recordedTime;
+            numMismatches += recordedRes != out;
+        }
+        std::cout << std::setw(8) << numChecks << std::setw(8) << cmd.line << std::setw(10) << out << std::setw(14)
+                  << elapsed.count() << (hasRecord ? trim(cmd.comment) : "-")
+                  << (hasRecord && recordedRes != out ? "  MISMATCH" : "") << "\n";
+    }
+    std::cout << numChecks << " checks: " << totalMs << " ms (recorded " << recordedMs << " ms), " << numMismatches
+              << " mismatches, " << numErrors << " errors\n";
+    return numMismatches || numErrors ? 2 : 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * Z3Slicing.cpp
+ * Cone-of-influence slicing of the constraints of GenericZ3Mgr: an index from symbols to the constraints using
+ * them, and the model of the last sliced query.
+ */
+
+#include "Z3Slicing.h"
+#include <unordered_set>
+
+using namespace SVF;
+
+void Z3Slicer::truncate(uint32_t num)
+{
+    // the index lists are in increasing order so the dropped constraints are at their ends
+    for (uint32_t i = num; i < constraintSyms.size(); i++)
+    {
+        for (uint64_t sym : constraintSyms[i])
+        {
+            std::vector<uint32_t> &cons = sym2Constraints[sym];
+            while (!cons.empty() && cons.back() >= num)
+                cons.pop_back();
+        }
+    }
+    while (!groundConstraints.empty() && groundConstraints.back() >= num)
+        groundConstraints.pop_back();
+    if (constraintSyms.size() > num)
+        constraintSyms.resize(num);
+}
+
+void Z3Slicer::getConeOfInfluence(std::vector<uint64_t> todo, std::vector<uint32_t> &coi) const
+{
+    std::unordered_set<uint64_t> visitedSyms;
+    std::vector<bool> inCOI(constraintSyms.size(), false);
+    for (uint32_t i : groundConstraints)
+        inCOI[i] = true;
+    while (!todo.empty())
+    {
+        uint64_t sym = todo.back();
+        todo.pop_back();
+        if (!visitedSyms.insert(sym).second)
+            continue;
+        auto it = sym2Constraints.find(sym);
+        if (it == sym2Constraints.end())
+            continue;
+        for (uint32_t i : it->second)
+        {
+            if (inCOI[i])
+                continue;
+            inCOI[i] = true;
+            todo.insert(todo.end(), constraintSyms[i].begin(), constraintSyms[i].end());
+        }
+    }
+
+    coi.clear();
+    for (uint32_t i = 0; i < inCOI.size(); i++)
+        if (inCOI[i])
+            coi.push_back(i);
+}
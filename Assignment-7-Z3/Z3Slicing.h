@@ -0,0 +1,86 @@
+/**
+ * Z3Slicing.h
+ * Cone-of-influence slicing of the constraints of GenericZ3Mgr: an index from symbols to the constraints using
+ * them, and the model of the last sliced query.
+ */
+
+#ifndef ANSWERS_DEV_Z3SLICING_H
+#define ANSWERS_DEV_Z3SLICING_H
+
+#include "z3++.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace SVF
+{
+
+/// The symbol -> constraints index of a constraint log, extended lazily to the constraints added since the last
+/// query and truncated with it. Symbols are keys computed by the manager (see GenericZ3Mgr::collectSymbols).
+class Z3Slicer
+{
+public:
+    explicit Z3Slicer(z3::context &ctx) : enabled(false), slicedGen(0), slicedModel(ctx)
+    {}
+
+    inline void setEnabled(bool enable)
+    {
+        enabled = enable;
+    }
+
+    inline bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /// Extend the index to constraints; collect(e, syms) appends the symbols of e to syms
+    template<class Collect>
+    void index(const z3::expr_vector &constraints, Collect collect)
+    {
+        for (uint32_t i = constraintSyms.size(); i < constraints.size(); i++)
+        {
+            constraintSyms.emplace_back();
+            std::vector<uint64_t> &syms = constraintSyms.back();
+            collect(constraints[i], syms);
+            if (syms.empty())
+                groundConstraints.push_back(i);
+            for (uint64_t sym : syms)
+                sym2Constraints[sym].push_back(i);
+        }
+    }
+
+    /// Drop the index entries of the constraints beyond the first num ones, e.g., when popping a scope
+    void truncate(uint32_t num);
+
+    /// Compute the indexed constraints that (transitively) share a symbol with todo, in increasing order.
+    /// Constraints without symbols are always included since they may make the whole set unsatisfiable.
+    void getConeOfInfluence(std::vector<uint64_t> todo, std::vector<uint32_t> &coi) const;
+
+    /// Return the model of the last sliced query if it was computed for the same solver generation and cone
+    inline const z3::model *getModel(uint32_t gen, const std::vector<uint32_t> &coi) const
+    {
+        return slicedGen == gen && coi == slicedCOI ? &slicedModel : nullptr;
+    }
+
+    /// Record the model of cone coi at solver generation gen
+    inline const z3::model &setModel(uint32_t gen, std::vector<uint32_t> &coi, const z3::model &m)
+    {
+        slicedModel = m;
+        slicedCOI.swap(coi);
+        slicedGen = gen;
+        return slicedModel;
+    }
+
+private:
+    bool enabled;                                   /// whether cone-of-influence slicing is used
+    std::vector<std::vector<uint64_t>> constraintSyms;  /// symbols of each indexed constraint
+    std::unordered_map<uint64_t, std::vector<uint32_t>> sym2Constraints; /// symbol -> constraints using it
+    std::vector<uint32_t> groundConstraints;        /// indexed constraints without any symbol
+    std::vector<uint32_t> slicedCOI;                /// constraints of the cached sliced model
+    uint32_t slicedGen;                             /// the solver generation that slicedModel was computed for
+    z3::model slicedModel;                          /// model of the last sliced query
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3SLICING_H
@@ -21,7 +21,8 @@ using namespace SVF;
  * assert(x==5);
  * }
  */
-void Z3Tests::test0()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test0()
 {
     expr p = getZ3Expr("p");
     expr q = getZ3Expr("q");
@@ -56,7 +57,8 @@ void Z3Tests::test0()
  * Simple integers
  * assert(b > 0);
  */
-void Z3Tests::test1()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test1()
 {
     expr a = getZ3Expr("a");
     expr b = getZ3Expr("b");
@@ -78,7 +80,8 @@ void Z3Tests::test1()
  * One-level pointers
  * assert(b > 3);
  */
-void Z3Tests::test2()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test2()
 {
     expr p = getZ3Expr("p");
     expr q = getZ3Expr("q");
@@ -110,7 +113,8 @@ void Z3Tests::test2()
  * Multiple-level pointers
  * assert(x==10);
  */
-void Z3Tests::test3()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test3()
 {
     expr p = getZ3Expr("p");
     expr q = getZ3Expr("q");
@@ -146,7 +150,8 @@ void Z3Tests::test3()
  * Array and pointers
  * assert((a + b)>20);
  */
-void Z3Tests::test4()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test4()
 {
     expr p = getZ3Expr("p");
     expr x = getZ3Expr("x");
@@ -185,7 +190,8 @@ void Z3Tests::test4()
  * Branches
  * assert(b1 >= 5);
  */
-void Z3Tests::test5()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test5()
 {
     expr a = getZ3Expr("a");
     expr b = getZ3Expr("b");
@@ -208,7 +214,8 @@ void Z3Tests::test5()
  * Compare and pointers
  * assert(*p == 5);
  */
-void Z3Tests::test6()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test6()
 {
     expr a = getZ3Expr("a");
     expr b = getZ3Expr("b");
@@ -239,7 +246,8 @@ void Z3Tests::test6()
 /*
  * assert(d == 5);
  */
-void Z3Tests::test7()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test7()
 {
     expr a = getZ3Expr("a");
     expr b = getZ3Expr("b");
@@ -269,7 +277,8 @@ void Z3Tests::test7()
  * Array branches
  * assert(*p == 0);
  */
-void Z3Tests::test8()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test8()
 {
     expr arr = getZ3Expr("arr");
     expr a = getZ3Expr("a");
@@ -303,7 +312,8 @@ void Z3Tests::test8()
  * Struct and pointers
  * assert(z == 15);
  */
-void Z3Tests::test9()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test9()
 {
     expr p = getZ3Expr("p");
     expr x = getZ3Expr("x");
@@ -350,7 +360,8 @@ void Z3Tests::test9()
  * Interprocedural
  * assert(x == 3 && y == 2);
  */
-void Z3Tests::test10()
+template<class Encoding>
+void GenericZ3Tests<Encoding>::test10()
 {
     expr x = getZ3Expr("x");
     expr y = getZ3Expr("y");
@@ -369,6 +380,11 @@ void Z3Tests::test10()
     std::cout << solver.check() << std::endl;
 }
 
+template class SVF::GenericZ3Tests<IntEncoding>;
+template class SVF::GenericZ3Tests<BV32Encoding>;
+template class SVF::GenericZ3Tests<BV64Encoding>;
+
+#ifndef Z3TESTS_NO_MAIN
 int main()
 {
     Z3Tests tests;
@@ -418,4 +434,5 @@ int main()
     tests.resetSolver();
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
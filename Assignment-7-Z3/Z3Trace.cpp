@@ -0,0 +1,123 @@
+/**
+ * Z3Trace.cpp
+ * SMT-LIB2 recording of GenericZ3Mgr sessions, re-run by the z3replay tool.
+ */
+
+#include "Z3Trace.h"
+#include <iostream>
+
+using namespace SVF;
+
+bool Z3Trace::open(const std::string &file, const std::string &encoding)
+{
+    close();
+    out.reset(new std::ofstream(file, std::ios::trunc));
+    if (!*out)
+    {
+        std::cerr << "cannot write the trace to " << file << "\n";
+        out.reset();
+        return false;
+    }
+    *out << "; Z3Mgr trace, encoding " << encoding << "\n";
+    *out << "(set-option :produce-models true)\n";
+    return true;
+}
+
+void Z3Trace::close()
+{
+    out.reset();
+    decls.clear();
+    declLog.clear();
+    declScopes.clear();
+    modelValid = false;
+}
+
+void Z3Trace::command(const std::string &cmd)
+{
+    *out << cmd << "\n";
+    modelValid = false;
+}
+
+void Z3Trace::declare(const z3::expr &e)
+{
+    std::unordered_set<unsigned> visited;
+    std::vector<z3::expr> todo;
+    todo.push_back(e);
+    while (!todo.empty())
+    {
+        z3::expr cur = todo.back();
+        todo.pop_back();
+        if (!visited.insert(cur.id()).second || !cur.is_app())
+            continue;
+        z3::func_decl decl = cur.decl();
+        if (decl.decl_kind() == Z3_OP_UNINTERPRETED && decls.insert(decl.id()).second)
+        {
+            declLog.push_back(decl.id());
+            command(decl.to_string());
+        }
+        for (unsigned i = 0; i < cur.num_args(); i++)
+            todo.push_back(cur.arg(i));
+    }
+}
+
+void Z3Trace::assertExpr(const z3::expr &e)
+{
+    declare(e);
+    command("(assert " + e.to_string() + ")");
+}
+
+void Z3Trace::reset()
+{
+    command("(reset)");
+    *out << "(set-option :produce-models true)\n";
+    decls.clear();
+    declLog.clear();
+    declScopes.clear();
+}
+
+void Z3Trace::push()
+{
+    command("(push 1)");
+    declScopes.push_back(declLog.size());
+}
+
+void Z3Trace::pop(unsigned n)
+{
+    command("(pop " + std::to_string(n) + ")");
+    unsigned size = declScopes[declScopes.size() - n];
+    for (unsigned i = size; i < declLog.size(); i++)
+        decls.erase(declLog[i]);
+    declLog.resize(size);
+    declScopes.resize(declScopes.size() - n);
+}
+
+void Z3Trace::check(const z3::expr *assumption, z3::check_result res, double timeMs)
+{
+    if (assumption)
+        command("(check-sat-assuming (" + assumption->to_string() + "))");
+    else
+        command("(check-sat)");
+    *out << "; " << res << " " << timeMs << " ms\n";
+    modelValid = !assumption && res == z3::sat;
+}
+
+/// get-value needs the model of the last check-sat, so the check is repeated if another command came in between
+/// (e.g., the model was cached, or taken from a scratch solver while the trace went on)
+void Z3Trace::eval(const z3::expr_vector &es)
+{
+    if (es.empty())
+        return;
+    std::string terms;
+    for (unsigned i = 0; i < es.size(); i++)
+    {
+        declare(es[i]);
+        terms += (i ? " " : "") + es[i].to_string();
+    }
+    if (!modelValid)
+    {
+        *out << "; re-check for get-value\n";
+        command("(check-sat)");
+        modelValid = true;
+    }
+    *out << "(get-value (" << terms << "))\n";
+}
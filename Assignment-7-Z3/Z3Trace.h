@@ -0,0 +1,65 @@
+/**
+ * Z3Trace.h
+ * SMT-LIB2 recording of GenericZ3Mgr sessions, re-run by the z3replay tool.
+ */
+
+#ifndef ANSWERS_DEV_Z3TRACE_H
+#define ANSWERS_DEV_Z3TRACE_H
+
+#include "z3++.h"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace SVF
+{
+
+/// An SMT-LIB2 script being recorded. The uninterpreted constants and functions are declared before their first
+/// use, and the declarations made in a scope are dropped when it is popped, so they are declared again if used.
+class Z3Trace
+{
+public:
+    Z3Trace() : modelValid(false)
+    {}
+
+    /// Start recording into file (truncated), with a header naming the encoding; return false if file cannot be
+    /// written
+    bool open(const std::string &file, const std::string &encoding);
+
+    /// Stop recording
+    void close();
+
+    inline bool isOpen() const
+    {
+        return out != nullptr;
+    }
+
+    /// Commands, each written as one line
+    ///@{
+    void command(const std::string &cmd);
+    /// Declare the uninterpreted constants and functions of e that have not been declared yet
+    void declare(const z3::expr &e);
+    void assertExpr(const z3::expr &e);
+    /// (reset) also drops the declarations and options
+    void reset();
+    void push();
+    void pop(unsigned n);
+    /// A check, followed by a comment with its result and time, e.g., "; sat 1.25 ms"
+    void check(const z3::expr *assumption, z3::check_result res, double timeMs);
+    /// get-value of es, under the model of a satisfiable check
+    void eval(const z3::expr_vector &es);
+    ///@}
+
+private:
+    std::unique_ptr<std::ofstream> out;
+    std::unordered_set<unsigned> decls;     /// ids of the declarations in scope
+    std::vector<unsigned> declLog;          /// the declarations, in order
+    std::vector<unsigned> declScopes;       /// size of declLog when each scope was pushed
+    bool modelValid;                        /// whether the last command is a satisfiable check-sat
+};
+
+} // namespace SVF
+
+#endif //ANSWERS_DEV_Z3TRACE_H
@@ -0,0 +1,916 @@
+/**
+ * Z3UnitTests.cpp
+ * Behaviour checks of GenericZ3Mgr and the components around it, on small hand-written constraint sets.
+ */
+
+#include "Z3Mgr.h"
+#include "Z3MgrPool.h"
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+using namespace SVF;
+
+namespace
+{
+
+unsigned numFailed = 0;
+
+/// Report a failed check (kept under NDEBUG, unlike assert)
+#define CHECK(cond) \
+    do { if (!(cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; numFailed++; } } while (0)
+
+/// Z3IntervalDomain: finite INT64_MIN/INT64_MAX bounds, strict comparisons at the int64_t limits, scopes and the
+/// assertions decided by GenericZ3Mgr before calling Z3
+void testIntervals()
+{
+    z3::context ctx;
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y"), z = ctx.int_const("z");
+    z3::expr maxVal = ctx.int_val(INT64_MAX), minVal = ctx.int_val(INT64_MIN);
+
+    Z3IntervalDomain domain;
+    CHECK(domain.check(x > 0) == Z3IntervalDomain::Unknown);
+    domain.assume(x == maxVal);
+    CHECK(domain.eval(x).isPoint() && domain.eval(x).lo == INT64_MAX);
+    CHECK(domain.check(x == maxVal) == Z3IntervalDomain::Holds);
+    CHECK(domain.check(x > 0) == Z3IntervalDomain::Holds);
+    CHECK(domain.isExact());
+    // x + 1 leaves int64_t but not the integers
+    CHECK(domain.check(x + 1 > x) != Z3IntervalDomain::Fails);
+
+    domain.push();
+    domain.assume(z == minVal);
+    CHECK(domain.eval(z).isPoint() && domain.eval(z).lo == INT64_MIN);
+    domain.assume(y < z);
+    CHECK(domain.eval(y).hi == (Interval::Bound) INT64_MIN - 1);
+    CHECK(domain.check(y < z) == Z3IntervalDomain::Holds);
+    CHECK(domain.check(y == minVal) == Z3IntervalDomain::Fails);
+    CHECK(!domain.isExact() && !domain.isInfeasible());
+    domain.pop(1);
+    CHECK(domain.eval(y).lo == Interval::NegInf && domain.eval(y).hi == Interval::PosInf);
+    CHECK(domain.isExact());
+
+    domain.push();
+    domain.assume(x < maxVal);
+    CHECK(domain.isInfeasible());
+    domain.pop(1);
+    CHECK(!domain.isInfeasible());
+
+    // bit-vectors: INT64_MIN is a finite BV64 value, and BV32 arithmetic may wrap around (b32 + 1 is the whole range,
+    // of which no value is above INT32_MAX)
+    z3::expr b64 = ctx.bv_const("b64", 64), b32 = ctx.bv_const("b32", 32);
+    domain.assume(b64 == ctx.bv_val(INT64_MIN, 64));
+    CHECK(domain.eval(b64).isPoint() && domain.eval(b64).lo == INT64_MIN);
+    domain.assume(b32 == ctx.bv_val(INT32_MAX, 32));
+    CHECK(domain.check(b32 + 1 > b32) == Z3IntervalDomain::Fails);
+    CHECK(domain.check(b32 - 1 < b32) == Z3IntervalDomain::Holds);
+
+    // the manager decides assertions with the intervals first
+    Z3Mgr mgr;
+    mgr.setIntervalAnalysis(true);
+    z3::expr a = mgr.getCtx().int_const("a");
+    mgr.addToSolver(a == 5);
+    CHECK(mgr.checkNegateAssert(a > 3));
+    CHECK(!mgr.checkNegateAssert(a > 7));
+    CHECK(!mgr.checkNegateAssert(a * a == a + a));
+    CHECK(mgr.getIntervalStats().proved == 1 && mgr.getIntervalStats().refuted == 2);
+    mgr.addToSolver(a + mgr.getCtx().int_const("b") > 0);
+    CHECK(mgr.checkNegateAssert(a == 5));
+    CHECK(!mgr.checkNegateAssert(mgr.getCtx().int_const("b") > 0));
+    CHECK(mgr.getIntervalStats().undecided == 1);
+}
+
+/// The contents of a file
+std::string readFile(const std::string &file)
+{
+    std::ifstream in(file);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+/// Lightweight resets: resetSolver keeps the declared variables and the names, restores the variables made addresses,
+/// and drops the constraints and stores of the session; the solver itself is reset every freshAfter constraints
+void testLightweightReset()
+{
+    Z3Tests tests;
+    tests.setLightweightReset(true, 4);
+    CHECK(tests.isLightweightReset());
+    z3::context &ctx = tests.getCtx();
+    z3::expr x = tests.getZ3Expr("x"), p = tests.getZ3Expr("p");
+    z3::expr obj = tests.getMemObjAddress("p");
+    CHECK(z3::eq(tests.getZ3Expr("p"), obj));
+    tests.addToSolver(x == 3);
+    tests.storeValue(obj, x);
+    CHECK(tests.checkNegateAssert(tests.loadValue(obj) == 3));
+
+    tests.resetSolver();
+    CHECK(z3::eq(tests.getZ3Expr("x"), x) && z3::eq(tests.getZ3Expr("p"), p));
+    CHECK(tests.hasZ3Expr("x"));
+    CHECK(!tests.checkNegateAssert(x == 3));
+    CHECK(!tests.checkNegateAssert(tests.loadValue(obj) == 3));
+    CHECK(Z3_solver_get_num_scopes(ctx, tests.getSolver()) == 1);
+
+    // 2 + 3 constraints reach freshAfter: the solver is reset rather than popped
+    tests.addToSolver(x == 4);
+    tests.addToSolver(x > 0);
+    tests.addToSolver(p == x);
+    CHECK(tests.checkNegateAssert(p == 4));
+    tests.resetSolver();
+    CHECK(tests.getSolver().assertions().size() == 0);
+    CHECK(Z3_solver_get_num_scopes(ctx, tests.getSolver()) == 1);
+    CHECK(!tests.checkNegateAssert(p == 4));
+
+    // a full reset drops the names
+    tests.setLightweightReset(false);
+    tests.resetSolver();
+    CHECK(!tests.hasZ3Expr("x"));
+}
+
+/// getUnsatCore: a minimal core of the tracked constraints, named by their labels, with the memory accesses of each
+void testUnsatCore()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    mgr.setCoreTracking(true);
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    z3::expr addr = ctx.int_val(mgr.getVirtualMemAddress(1));
+    mgr.addToSolver(x > 5, "a");
+    mgr.addToSolver(y == 1, "b");
+    UnsatCore sat = mgr.getUnsatCore();
+    CHECK(sat.res == z3::sat && sat.statements.empty());
+
+    mgr.pushSolver();
+    mgr.addToSolver(x < y + 2, "c");
+    mgr.addToSolver(x > 0);
+    mgr.storeValue(addr, x);
+    mgr.addToSolver(mgr.loadValue(addr) == y, "d");
+    UnsatCore core = mgr.getUnsatCore();
+    CHECK(core.res == z3::unsat && core.minimal);
+    std::vector<std::string> labels;
+    for (const CoreStatement &st : core.statements)
+        labels.push_back(st.label);
+    CHECK(labels == std::vector<std::string>({"a", "b", "c"}) || labels == std::vector<std::string>({"a", "b", "d"}));
+
+    // the popped constraints leave the core, and the load of e is reported as one of its memory accesses
+    mgr.popSolver();
+    mgr.addToSolver(mgr.loadValue(addr) < 3, "e");
+    core = mgr.getUnsatCore();
+    CHECK(core.res == z3::unsat && core.statements.size() == 2);
+    CHECK(core.statements.size() == 2 && core.statements[0].label == "a" && core.statements[1].label == "e");
+    CHECK(core.statements.size() == 2 && !core.statements[1].sites.empty() && core.statements[0].sites.empty());
+
+    // solvers made from tactics do not report cores, so the core is computed without the pipeline
+    mgr.setSolverConfig(Z3SolverConfig::parse("tactics=simplify+smt"));
+    core = mgr.getUnsatCore();
+    CHECK(core.res == z3::unsat && core.minimal && core.statements.size() == 2);
+}
+
+/// Whether e has a sub-expression of an array sort
+bool hasArray(const z3::expr &e)
+{
+    if (e.get_sort().is_array())
+        return true;
+    if (e.is_app())
+        for (unsigned i = 0; i < e.num_args(); i++)
+            if (hasArray(e.arg(i)))
+                return true;
+    return false;
+}
+
+/// FlatMem: one value per cell, without the array theory; symbolic accesses are ite chains over the registered
+/// objects and fields
+void testFlatMem()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    mgr.setMemModel(Z3Mgr::FlatMem);
+    mgr.addMemObj(1);
+    mgr.addGepObj(3, 1, 1);
+    mgr.addMemObj(2);
+    z3::expr addr1 = ctx.int_val(mgr.getVirtualMemAddress(1)), addr2 = ctx.int_val(mgr.getVirtualMemAddress(2));
+    z3::expr field = ctx.int_val(mgr.getVirtualMemAddress(3));
+    z3::expr p = ctx.int_const("p");
+
+    mgr.storeValue(addr1, ctx.int_val(4));
+    mgr.storeValue(addr2, ctx.int_val(6));
+    mgr.storeValue(field, ctx.int_val(8));
+    CHECK(mgr.loadValue(addr1).get_numeral_int() == 4);
+    CHECK(mgr.loadValue(field).get_numeral_int() == 8);
+
+    mgr.addToSolver(p == addr1 || p == field);
+    z3::expr v = mgr.loadValue(p);
+    CHECK(!hasArray(v) && v.is_app() && v.decl().decl_kind() == Z3_OP_ITE);
+    CHECK(mgr.checkNegateAssert(v == 4 || v == 8));
+    CHECK(!mgr.checkNegateAssert(v == 4));
+
+    // a symbolic store may hit either cell, but not object 2
+    mgr.storeValue(p, ctx.int_val(9));
+    z3::expr v1 = mgr.loadValue(addr1), v3 = mgr.loadValue(field);
+    CHECK(!hasArray(v1) && !hasArray(v3));
+    CHECK(mgr.checkNegateAssert(v1 == 9 || v3 == 9));
+    CHECK(!mgr.checkNegateAssert(v1 == 9));
+    CHECK(mgr.checkNegateAssert(mgr.loadValue(addr2) == 6));
+    CHECK(mgr.checkNegateAssert(mgr.loadValue(p) == 9));
+
+    // no store reaches loc2ValMap or the asserted formulas
+    mgr.addToSolver(mgr.loadValue(p) > 0);
+    CHECK(mgr.getLoc2ValMap().is_const());
+    z3::expr_vector asserted = mgr.getSolver().assertions();
+    for (u32_t i = 0; i < asserted.size(); i++)
+        CHECK(!hasArray(asserted[i]));
+}
+
+/// The lines of text that are exactly one of the given words
+std::vector<std::string> getWordLines(const std::string &text, const std::set<std::string> &words)
+{
+    std::vector<std::string> found;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        std::string word = line.substr(0, line.find(' '));
+        if (line.rfind("; ", 0) == 0)
+            word = line.substr(2, line.find(' ', 2) - 2);
+        if (words.count(word))
+            found.push_back(word);
+    }
+    return found;
+}
+
+/// Z3Trace: the recorded script declares every symbol before its use (again after a reset), and re-running it in a
+/// fresh context gives the recorded results
+void testTrace()
+{
+    std::string traceFile = "z3unittests.session.smt2";
+    {
+        Z3Mgr mgr;
+        mgr.setTrace(traceFile);
+        z3::context &ctx = mgr.getCtx();
+        z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+        z3::expr addr = ctx.int_val(mgr.getVirtualMemAddress(1));
+        mgr.addToSolver(x > 2);
+        mgr.pushSolver();
+        mgr.addToSolver(y == x + 1);
+        CHECK(mgr.getEvalExpr(y).get_numeral_int() > 3);
+        CHECK(mgr.checkNegateAssert(y > 3));
+        CHECK(!mgr.checkNegateAssert(y > 4));
+        mgr.popSolver();
+        mgr.storeValue(addr, x);
+        CHECK(mgr.getEvalExpr(mgr.loadValue(addr)).get_numeral_int() > 2);
+        mgr.resetSolverState();
+        mgr.addToSolver(y < 0);
+        CHECK(mgr.getEvalExpr(y).get_numeral_int() < 0);
+    }
+    std::string trace = readFile(traceFile);
+    std::remove(traceFile.c_str());
+    CHECK(trace.find("(declare-fun loc2ValMap () (Array Int Int))") != std::string::npos);
+    size_t first = trace.find("(declare-fun y () Int)"), reset = trace.find("(reset)");
+    CHECK(first < reset && trace.find("(declare-fun y () Int)", reset) != std::string::npos);
+    CHECK(trace.find("(check-sat-assuming ((not (> y 3))))") != std::string::npos);
+    std::set<std::string> results = {"sat", "unsat", "unknown"};
+    std::vector<std::string> recorded = getWordLines(trace, results);
+    CHECK(recorded == std::vector<std::string>({"sat", "unsat", "sat", "sat", "sat"}));
+
+    // the re-check before the get-value of the load is the only check without a recorded result
+    z3::context ctx;
+    std::string replay = Z3_eval_smtlib2_string(ctx, trace.c_str());
+    CHECK(replay.find("error") == std::string::npos);
+    CHECK(getWordLines(replay, results) == std::vector<std::string>({"sat", "unsat", "sat", "sat", "sat", "sat"}));
+}
+
+/// Z3MgrPool: jobs run on the workers' own managers, and parallel assertion checks match the sequential ones,
+/// including under the definitions of constant propagation
+void testPool()
+{
+    Z3MgrPool pool(2);
+    CHECK(pool.getNumThreads() == 2);
+    std::vector<std::future<int>> sums;
+    for (int i = 0; i < 8; i++)
+        sums.push_back(pool.submit([i](Z3Mgr &mgr)
+        {
+            z3::expr v = mgr.getCtx().int_const("v");
+            mgr.pushSolver();
+            mgr.addToSolver(v == i + 1);
+            int val = mgr.getEvalExpr(v * 2).get_numeral_int();
+            mgr.popSolver();
+            return val;
+        }));
+    for (int i = 0; i < 8; i++)
+        CHECK(sums[i].get() == 2 * (i + 1));
+
+    Z3Mgr src;
+    src.setConstantPropagation(true);
+    z3::context &ctx = src.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    src.addToSolver(x == 3);
+    src.addToSolver(y > x);
+    z3::expr_vector qs(ctx);
+    for (int i = 0; i < 6; i++)
+        qs.push_back(y > i);
+    std::vector<std::future<AssertCheckResult>> results = pool.checkNegateAssertsAsync(src, qs);
+    CHECK(results.size() == 6);
+    for (u32_t i = 0; i < results.size(); i++)
+        CHECK(results[i].get().holds() == (i <= 3));
+    CHECK(src.getConstraints().size() == 2);
+}
+
+/// Constant propagation: definitions become substitutions instead of solver constraints, later constraints and
+/// queries are folded with them, and they are popped with their scope
+void testConstantPropagation()
+{
+    Z3Mgr mgr;
+    mgr.setConstantPropagation(true);
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y"), z = ctx.int_const("z");
+    mgr.addToSolver(x == 5);
+    mgr.addToSolver(y == x + 1);
+    mgr.addToSolver(x > 0);
+    CHECK(mgr.getSolver().assertions().size() == 0);
+    CHECK(mgr.getConstraints().size() == 2);
+    CHECK(mgr.getEvalExpr(y).get_numeral_int() == 6);
+    CHECK(z3::eq(mgr.propagateConstants(x * y), ctx.int_val(30)));
+
+    // a constraint over an unknown variable is sent folded
+    mgr.addToSolver(z > y);
+    z3::expr_vector sent = mgr.getSolver().assertions();
+    CHECK(sent.size() == 1 && z3::eq(sent[0], (z > 6).simplify()));
+    CHECK(mgr.checkNegateAssert(z > 6));
+    CHECK(!mgr.checkNegateAssert(z > 7));
+
+    // once z is in the solver, its definition is sent too
+    mgr.pushSolver();
+    mgr.addToSolver(z == 9);
+    CHECK(mgr.getSolver().assertions().size() == 2);
+    CHECK(mgr.checkNegateAssert(z + y == 15));
+    mgr.popSolver();
+    CHECK(mgr.getConstraints().size() == 2 + 1);
+    CHECK(!mgr.checkNegateAssert(z == 9));
+
+    // updateZ3Expr folds a non-variable target
+    mgr.updateZ3Expr(1, x + y);
+    CHECK(z3::eq(mgr.getZ3Expr(1), ctx.int_val(11)));
+}
+
+/// Query cache: results are keyed by the structure of the constraints and the query, whatever the order of the
+/// constraints or the context, and survive in the cache file
+void testQueryCache()
+{
+    std::string cacheFile = "z3unittests.cache";
+    std::remove(cacheFile.c_str());
+    {
+        Z3Mgr mgr;
+        mgr.setQueryCache(16, cacheFile);
+        z3::context &ctx = mgr.getCtx();
+        z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+        mgr.addToSolver(x == 4);
+        mgr.addToSolver(y == x + 1);
+        CHECK(mgr.getEvalExpr(y).get_numeral_int() == 5);
+        CHECK(mgr.checkNegateAssert(y > x));
+        CHECK(mgr.getQueryCache()->getHits() == 0 && mgr.getQueryCache()->getMisses() == 2);
+        CHECK(mgr.getEvalExpr(y).get_numeral_int() == 5);
+        CHECK(mgr.checkNegateAssert(y > x));
+        CHECK(mgr.getQueryCache()->getHits() == 2);
+
+        // a popped constraint no longer matches
+        mgr.pushSolver();
+        mgr.addToSolver(x > 0);
+        CHECK(mgr.checkNegateAssert(y > x));
+        CHECK(mgr.getQueryCache()->getMisses() == 3);
+        mgr.popSolver();
+        CHECK(mgr.checkNegateAssert(y > x));
+        CHECK(mgr.getQueryCache()->getHits() == 3);
+    }
+    CHECK(!readFile(cacheFile).empty());
+
+    // a later manager reads the results back, with the constraints added in another order
+    Z3Mgr mgr;
+    mgr.setQueryCache(16, cacheFile);
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    mgr.addToSolver(y == x + 1);
+    mgr.addToSolver(x == 4);
+    CHECK(mgr.getEvalExpr(y).get_numeral_int() == 5);
+    CHECK(mgr.checkNegateAssert(y > x));
+    CHECK(!mgr.checkNegateAssert(y < x));
+    CHECK(mgr.getQueryCache()->getHits() == 2 && mgr.getQueryCache()->getMisses() == 1);
+    mgr.setQueryCache(0);
+
+    // managers sharing the file merge their entries instead of overwriting each other's
+    {
+        Z3Mgr first, second;
+        first.setQueryCache(16, cacheFile);
+        second.setQueryCache(16, cacheFile);
+        z3::expr a = first.getCtx().int_const("a"), b = second.getCtx().int_const("b");
+        first.addToSolver(a == 1);
+        second.addToSolver(b == 2);
+        CHECK(first.getEvalExpr(a + 1).get_numeral_int() == 2);
+        CHECK(second.getEvalExpr(b + 1).get_numeral_int() == 3);
+    }
+    Z3Mgr merged;
+    merged.setQueryCache(16, cacheFile);
+    z3::expr a = merged.getCtx().int_const("a"), b = merged.getCtx().int_const("b");
+    merged.pushSolver();
+    merged.addToSolver(a == 1);
+    CHECK(merged.getEvalExpr(a + 1).get_numeral_int() == 2);
+    merged.popSolver();
+    merged.pushSolver();
+    merged.addToSolver(b == 2);
+    CHECK(merged.getEvalExpr(b + 1).get_numeral_int() == 3);
+    merged.popSolver();
+    z3::expr mx = merged.getCtx().int_const("x"), my = merged.getCtx().int_const("y");
+    merged.addToSolver(mx == 4);
+    merged.addToSolver(my == mx + 1);
+    CHECK(merged.getEvalExpr(my).get_numeral_int() == 5);
+    CHECK(merged.getQueryCache()->getHits() == 3 && merged.getQueryCache()->getMisses() == 0);
+    merged.setQueryCache(0);
+    std::remove(cacheFile.c_str());
+}
+
+/// Z3SolverConfig: parsing, and the constraints and scopes replayed into the solver of every configuration
+void testSolverConfig()
+{
+    Z3SolverConfig config = Z3SolverConfig::parse("logic=auto,tactics=simplify+smt,timeout=500,rlimit=7,incremental=0");
+    CHECK(config.logic == "auto" && config.tactics == std::vector<std::string>({"simplify", "smt"}));
+    CHECK(config.timeoutMs == 500 && config.rlimit == 7 && !config.incremental);
+    CHECK(Z3SolverConfig::parse("tactics=default").tactics == Z3SolverConfig::defaultTactics());
+    CHECK(Z3SolverConfig::parse("").isDefault() && !config.isDefault());
+
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    mgr.addToSolver(x > 3);
+    mgr.pushSolver();
+    mgr.addToSolver(y == x * 2);
+    for (const char *spec : {"logic=auto", "logic=QF_NIA", "tactics=default", "timeout=10000,rlimit=100000000",
+                             "incremental=0", ""})
+    {
+        mgr.setSolverConfig(Z3SolverConfig::parse(spec));
+        CHECK(Z3_solver_get_num_scopes(ctx, mgr.getSolver()) == 1);
+        CHECK(mgr.checkNegateAssert(y > 6));
+        CHECK(!mgr.checkNegateAssert(y > 8));
+        CHECK(mgr.getEvalExpr(y).get_numeral_int() == 2 * mgr.getEvalExpr(x).get_numeral_int());
+        mgr.popSolver();
+        CHECK(!mgr.checkNegateAssert(y > 6));
+        mgr.pushSolver();
+        mgr.addToSolver(y == x * 2);
+    }
+}
+
+/// An encoding: negative values and virtual addresses round-trip through the memory and the models, and the
+/// largest value of the encoding (if any) wraps around
+template<class Encoding>
+void testEncoding(int64_t maxVal, bool wraps)
+{
+    GenericZ3Mgr<Encoding> mgr;
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.constant("x", Encoding::getSort(ctx)), p = ctx.constant("p", Encoding::getSort(ctx));
+    z3::expr addr = Encoding::getVal(ctx, mgr.getVirtualMemAddress(3));
+    mgr.addToSolver(p == addr);
+    mgr.storeValue(addr, Encoding::getVal(ctx, -5));
+    mgr.addToSolver(x == mgr.loadValue(p));
+    CHECK(mgr.checkNegateAssert(x < 0));
+    CHECK(mgr.z3Expr2NumValue(mgr.getEvalExpr(x)) == -5);
+    CHECK(mgr.isVirtualMemAddress(mgr.getEvalExpr(p)));
+
+    z3::expr_vector es(ctx);
+    es.push_back(x);
+    es.push_back(p);
+    EvalValues vals = mgr.getEvalValues(es);
+    CHECK(vals.isNumeral[0] && vals.values[0] == -5);
+    CHECK(vals.isNumeral[1] && vals.values[1] == mgr.getVirtualMemAddress(3));
+
+    z3::expr y = ctx.constant("y", Encoding::getSort(ctx));
+    mgr.addToSolver(y == Encoding::getVal(ctx, maxVal));
+    CHECK(mgr.checkNegateAssert(y > 0));
+    CHECK(mgr.checkNegateAssert(y + 1 < 0) == wraps);
+    CHECK(mgr.checkNegateAssert(y + 1 > y) == !wraps);
+}
+
+/// getEvalValues: a batch of expressions is evaluated against one model, with a single solver check
+void testEvalValues()
+{
+    Z3Instrumentation &inst = Z3Instrumentation::getInstance();
+    inst.clear();
+    Z3Mgr mgr;
+    mgr.setInstrumentation(true);
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    mgr.addToSolver(x + y == 10);
+    mgr.addToSolver(x > 2);
+    mgr.updateZ3Expr(1, x);
+    mgr.updateZ3Expr(2, y);
+    mgr.updateZ3Expr(4, x * 2);
+
+    z3::expr_vector es(ctx);
+    es.push_back(x);
+    es.push_back(y);
+    es.push_back(x + y);
+    es.push_back(ctx.int_val(-7));
+    es.push_back(x > 0);
+    EvalValues vals = mgr.getEvalValues(es);
+    CHECK(vals.values.size() == 5 && vals.isNumeral.size() == 5);
+    CHECK(vals.isNumeral[0] && vals.isNumeral[1] && vals.isNumeral[2] && vals.isNumeral[3] && !vals.isNumeral[4]);
+    CHECK(vals.values[0] > 2 && vals.values[0] + vals.values[1] == 10 && vals.values[2] == 10);
+    CHECK(vals.values[3] == -7);
+
+    // IDs without an expression are skipped
+    EvalValues range = mgr.getEvalValues(0, 5);
+    CHECK(range.ids == std::vector<u32_t>({1, 2, 4}) && range.values.size() == 3);
+    CHECK(range.isNumeral[0] && range.isNumeral[1] && range.isNumeral[2]);
+    CHECK(range.values[0] == vals.values[0] && range.values[1] == vals.values[1]);
+    CHECK(range.values[2] == 2 * range.values[0]);
+
+    // sparse IDs far apart (named variables, fields) only cost the chunks they live in
+    mgr.updateZ3Expr(Z3Tests::GepObjTag + 3, y);
+    mgr.updateZ3Expr(0xfff002, x + 1);
+    range = mgr.getEvalValues(2, 0xfff003);
+    CHECK(range.ids == std::vector<u32_t>({2, 4, Z3Tests::GepObjTag + 3, 0xfff002}));
+    CHECK(range.values.size() == 4 && range.isNumeral[3] && range.values[3] == vals.values[0] + 1);
+    CHECK(mgr.getEvalValues(5, Z3Tests::GepObjTag + 3).ids.empty());
+
+    std::stringstream json;
+    inst.exportJSON(json);
+    CHECK(json.str().find("\"check\": {\"count\": 1,") != std::string::npos);
+    inst.clear();
+}
+
+/// Slicing: the cone of influence of a query only holds the constraints sharing a variable with it (and the ground
+/// ones), and the sliced results match the unsliced ones
+void testSlicing()
+{
+    Z3Mgr sliced, full;
+    sliced.setSlicing(true);
+    for (Z3Mgr *mgr : {&sliced, &full})
+    {
+        z3::context &ctx = mgr->getCtx();
+        z3::expr x = ctx.int_const("x"), y = ctx.int_const("y"), z = ctx.int_const("z"), w = ctx.int_const("w");
+        mgr->addToSolver(x == 1);
+        mgr->addToSolver(z == 5);
+        mgr->addToSolver(y == x + 1);
+        mgr->addToSolver(ctx.int_val(1) < ctx.int_val(2));
+        mgr->addToSolver(w > z);
+        CHECK(mgr->getEvalExpr(y).get_numeral_int() == 2);
+        CHECK(mgr->getEvalExpr(w).get_numeral_int() > 5);
+        CHECK(mgr->checkNegateAssert(w > y + 3));
+        CHECK(!mgr->checkNegateAssert(w == 6));
+
+        z3::expr_vector ys(ctx), es(ctx);
+        ys.push_back(y);
+        std::vector<u32_t> coi;
+        mgr->getConeOfInfluence(ys, coi);
+        CHECK(coi == std::vector<u32_t>({0, 2, 3}));
+        es.push_back(w);
+        mgr->getConeOfInfluence(es, coi);
+        CHECK(coi == std::vector<u32_t>({1, 3, 4}));
+
+        // a popped constraint leaves the cones
+        mgr->pushSolver();
+        mgr->addToSolver(w == y + 10);
+        mgr->getConeOfInfluence(es, coi);
+        CHECK(coi == std::vector<u32_t>({0, 1, 2, 3, 4, 5}));
+        CHECK(mgr->getEvalExpr(w).get_numeral_int() == 12);
+        mgr->popSolver();
+        mgr->getConeOfInfluence(es, coi);
+        CHECK(coi == std::vector<u32_t>({1, 3, 4}));
+        CHECK(!mgr->checkNegateAssert(w == 12));
+    }
+}
+
+/// getModel: the model is computed once and reused by the evaluations until the solver changes
+void testModelCache()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x"), y = ctx.int_const("y");
+    mgr.addToSolver(x == 3);
+    mgr.addToSolver(y > x);
+    z3::model first = mgr.getModel();
+    CHECK(mgr.getModelStatus() == Z3Sat);
+    CHECK(mgr.getEvalExpr(x).get_numeral_int() == 3);
+    CHECK(mgr.getEvalExpr(y).get_numeral_int() > 3);
+    CHECK((Z3_model) mgr.getModel() == (Z3_model) first);
+
+    // a new constraint, a new scope or an explicit invalidation recomputes the model
+    mgr.addToSolver(y > 10);
+    CHECK((Z3_model) mgr.getModel() != (Z3_model) first);
+    CHECK(mgr.getEvalExpr(y).get_numeral_int() > 10);
+    z3::model second = mgr.getModel();
+    mgr.pushSolver();
+    mgr.addToSolver(y == 20);
+    CHECK(mgr.getEvalExpr(y).get_numeral_int() == 20);
+    mgr.popSolver();
+    CHECK((Z3_model) mgr.getModel() != (Z3_model) second);
+    second = mgr.getModel();
+    mgr.invalidateModel();
+    CHECK((Z3_model) mgr.getModel() != (Z3_model) second);
+    CHECK(mgr.getEvalExpr(x).get_numeral_int() == 3);
+}
+
+/// Z3StoreDepths and Z3Instrumentation: memoized store depths, and a summary of every event with only the first
+/// events kept
+void testInstrumentation()
+{
+    z3::context ctx;
+    z3::sort intSort = ctx.int_sort();
+    z3::expr mem = ctx.constant("mem", ctx.array_sort(intSort, intSort));
+    std::vector<z3::expr> mems;
+    Z3StoreDepths depths;
+    CHECK(depths.get(mem) == 0);
+    for (int i = 0; i < 100; i++)
+    {
+        mem = z3::store(mem, ctx.int_val(i), ctx.int_val(i));
+        mems.push_back(mem);
+        if (i % 10 == 0)
+            CHECK(depths.get(mem) == (unsigned) i + 1);
+    }
+    CHECK(depths.get(mems[54]) == 55);
+    CHECK(depths.get(z3::store(mems[54], ctx.int_val(0), ctx.int_val(1))) == 56);
+    CHECK(depths.get(mem) == 100);
+
+    Z3Instrumentation &inst = Z3Instrumentation::getInstance();
+    inst.clear();
+    inst.setMaxEvents(3);
+    {
+        Z3Mgr mgr;
+        mgr.setInstrumentation(true);
+        for (u32_t i = 1; i <= 5; i++)
+            mgr.storeValue(mgr.getCtx().int_val(mgr.getVirtualMemAddress(i)), mgr.getCtx().int_val(i));
+    }
+    std::stringstream json;
+    inst.exportJSON(json);
+    std::string out = json.str();
+    CHECK(out.find("\"storeValue\": {\"count\": 5,") != std::string::npos);
+    CHECK(out.find("\"dropped\": 2,") != std::string::npos);
+    CHECK(out.find("\"memDepth\": 3") != std::string::npos && out.find("\"memDepth\": 4") == std::string::npos);
+    inst.setMaxEvents(Z3Instrumentation::DefaultMaxEvents);
+    inst.clear();
+}
+
+/// GenericZ3Tests: field objects are numbered in their own range, in the order they are first used
+void testGepObjIDs()
+{
+    Z3Tests tests;
+    z3::expr p = tests.getZ3Expr("p"), q = tests.getZ3Expr("q");
+    tests.addToSolver(p == tests.getMemObjAddress("malloc1"));
+    tests.addToSolver(q == tests.getMemObjAddress("malloc2"));
+    u32_t first = tests.getVirtualMemAddress(Z3Tests::GepObjTag);
+
+    z3::expr f1 = tests.getGepObjAddress(p, 1);
+    CHECK(z3::eq(f1, tests.getZ3Expr(first)));
+    CHECK(z3::eq(tests.getGepObjAddress(q, 1), tests.getZ3Expr(first + 1)));
+    CHECK(z3::eq(tests.getGepObjAddress(p, 2), tests.getZ3Expr(first + 2)));
+    CHECK(z3::eq(tests.getGepObjAddress(p, 1), f1));
+    CHECK(z3::eq(tests.getGepObjAddress(p, 0), p));
+
+    // many named variables later, the field ids are neither taken nor moved
+    for (u32_t i = 0; i < 300; i++)
+    {
+        z3::expr v = tests.getZ3Expr("v" + std::to_string(i));
+        CHECK(v.is_const() && !v.is_numeral());
+    }
+    CHECK(z3::eq(tests.getGepObjAddress(p, 1), f1));
+    CHECK(z3::eq(tests.getGepObjAddress(q, 3), tests.getZ3Expr(first + 3)));
+
+    tests.resetSolver();
+    z3::expr r = tests.getZ3Expr("r");
+    tests.addToSolver(r == tests.getMemObjAddress("malloc"));
+    CHECK(z3::eq(tests.getGepObjAddress(r, 4), tests.getZ3Expr(first)));
+}
+
+/// RegionMem: stores routed to a region reach loc2ValMap only when a symbolic access needs them
+void testRegionStores()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    mgr.setMemModel(Z3Mgr::RegionMem);
+    mgr.addMemObj(1);
+    mgr.addMemObj(2);
+    z3::expr addr1 = ctx.int_val(mgr.getVirtualMemAddress(1)), addr2 = ctx.int_val(mgr.getVirtualMemAddress(2));
+    z3::expr p = ctx.int_const("p");
+
+    // a single-cell region is its value
+    z3::expr five = ctx.int_val(5);
+    CHECK(z3::eq(mgr.storeValue(addr1, five), five));
+    CHECK(z3::eq(mgr.loadValue(addr1), five));
+    mgr.storeValue(addr2, five);
+    CHECK(mgr.checkNegateAssert(z3::select(mgr.getLoc2ValMap(), addr1) == 5));
+
+    // a symbolic load sees the routed stores
+    mgr.addToSolver(p == addr1 || p == addr2);
+    mgr.storeValue(addr1, ctx.int_val(6));
+    CHECK(mgr.checkNegateAssert(mgr.loadValue(p) >= 5));
+    CHECK(!mgr.checkNegateAssert(mgr.loadValue(p) == 5));
+
+    // after a symbolic store, concrete stores and loads go through loc2ValMap
+    mgr.storeValue(p, ctx.int_val(8));
+    mgr.storeValue(addr1, ctx.int_val(3));
+    CHECK(mgr.checkNegateAssert(mgr.loadValue(addr1) == 3));
+    z3::expr v2 = mgr.loadValue(addr2);
+    CHECK(mgr.checkNegateAssert(v2 == 5 || v2 == 8));
+    CHECK(!mgr.checkNegateAssert(v2 == 5));
+}
+
+/// getVarID: a constant set through updateZ3Expr keeps its SVFVar ID after the variable is overwritten, and its AST
+/// id is never taken over by another expression
+void testVarIDs()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    u32_t idx;
+    {
+        z3::expr a = ctx.int_const("a");
+        mgr.updateZ3Expr(5, a);
+        CHECK(mgr.getVarID(a, idx) && idx == 5);
+        mgr.updateZ3Expr(5, ctx.int_val(7));
+    }
+    for (u32_t i = 0; i < 1000; i++)
+    {
+        std::string name = "fresh" + std::to_string(i);
+        z3::expr e = ctx.int_const(name.c_str()) * (int) i;
+        CHECK(!mgr.getVarID(e, idx) && !mgr.getVarID(e.arg(0), idx));
+    }
+    CHECK(mgr.getVarID(ctx.int_const("a"), idx) && idx == 5);
+    mgr.clearVarID2ExprMap();
+    CHECK(!mgr.getVarID(ctx.int_const("a"), idx));
+}
+
+/// checkNegateAssertsAsync: the checks run in a private context while the manager keeps working, and their
+/// counterexamples come back in the manager's context
+void testAsyncAsserts()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x");
+    mgr.addToSolver(x > 3);
+    z3::expr_vector qs(ctx);
+    qs.push_back(x > 2);
+    qs.push_back(x > 5);
+
+    Z3CheckHandle handle = mgr.checkNegateAssertsAsync(qs, true);
+    mgr.addToSolver(x < 100);
+    CHECK(mgr.checkNegateAssert(x < 200));
+    CHECK(!mgr.checkNegateAssert(x < 50));
+    std::vector<AssertCheckResult> results = handle.get();
+    CHECK(results.size() == 2);
+    CHECK(results[0].holds() && results[0].status == Z3Unsat);
+    CHECK(!results[1].holds() && results[1].status == Z3Sat);
+    CHECK(results[1].cex && &results[1].cex->ctx() == &ctx);
+    CHECK(results[1].cex && results[1].cex->eval(x).get_numeral_int() <= 5);
+
+    // a passed deadline skips every check
+    Z3CheckHandle late = mgr.checkNegateAssertsAsync(qs, Z3CheckControl::Clock::now());
+    for (const AssertCheckResult &r : late.get())
+        CHECK(r.status == Z3Timeout);
+
+    // a cancellation only interrupts the job's context
+    z3::expr_vector single(ctx);
+    single.push_back(x > 2);
+    Z3CheckHandle cancelled = mgr.checkNegateAssertsAsync(single);
+    cancelled.cancel();
+    std::vector<AssertCheckResult> res = cancelled.get();
+    CHECK(res.size() == 1 && (res[0].status == Z3Cancelled || res[0].status == Z3Unsat));
+    CHECK(mgr.checkNegateAssert(x > 2));
+    CHECK(!mgr.checkNegateAssert(x > 5));
+}
+
+/// Memory models: an access is routed to a single cell only if its address is unique, not just a model value
+void testUniqueAddresses()
+{
+    for (Z3Mgr::MemModel model : {Z3Mgr::RegionMem, Z3Mgr::FlatMem})
+    {
+        Z3Mgr mgr;
+        z3::context &ctx = mgr.getCtx();
+        mgr.setMemModel(model);
+        mgr.addMemObj(1);
+        mgr.addMemObj(2);
+        z3::expr addr1 = ctx.int_val(mgr.getVirtualMemAddress(1)), addr2 = ctx.int_val(mgr.getVirtualMemAddress(2));
+        z3::expr p = ctx.int_const("p"), q = ctx.int_const("q");
+
+        // p may be either object: the store may hit either, so neither load is known to be 7
+        mgr.addToSolver(p == addr1 || p == addr2);
+        mgr.storeValue(p, ctx.int_val(7));
+        z3::expr v1 = mgr.loadValue(addr1), v2 = mgr.loadValue(addr2);
+        CHECK(!mgr.checkNegateAssert(v1 == 7));
+        CHECK(!mgr.checkNegateAssert(v2 == 7));
+        CHECK(mgr.checkNegateAssert(v1 == 7 || v2 == 7));
+
+        // q can only be object 2, which the solver proves
+        mgr.addToSolver(q - 1 == addr1);
+        mgr.storeValue(q, ctx.int_val(9));
+        CHECK(mgr.checkNegateAssert(mgr.loadValue(addr2) == 9));
+    }
+
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    mgr.setShadowMemory(true);
+    z3::expr addr1 = ctx.int_val(mgr.getVirtualMemAddress(1)), addr2 = ctx.int_val(mgr.getVirtualMemAddress(2));
+    z3::expr p = ctx.int_const("p");
+    mgr.addToSolver(p == addr1 || p == addr2);
+    mgr.storeValue(addr1, ctx.int_val(1));
+    mgr.storeValue(p, ctx.int_val(7));
+    CHECK(!mgr.checkNegateAssert(mgr.loadValue(addr1) == 1));
+    CHECK(!mgr.checkNegateAssert(mgr.loadValue(addr1) == 7));
+
+    // numeral addresses need no proof, and the proof for q holds until the solver changes
+    Z3Instrumentation &inst = Z3Instrumentation::getInstance();
+    Z3Mgr region;
+    region.setMemModel(Z3Mgr::RegionMem);
+    region.setInstrumentation(true);
+    region.addMemObj(1);
+    z3::expr raddr1 = region.getCtx().int_val(region.getVirtualMemAddress(1));
+    z3::expr q = region.getCtx().int_const("q");
+    region.addToSolver(q == raddr1);
+    region.storeValue(q, region.getCtx().int_val(3));
+    inst.clear();
+    region.storeValue(raddr1, region.getCtx().int_val(4));
+    for (u32_t i = 0; i < 3; i++)
+        region.loadValue(q);
+    std::stringstream json;
+    inst.exportJSON(json);
+    CHECK(json.str().find("\"check\": {\"count\": 0,") != std::string::npos);
+    inst.clear();
+}
+
+/// checkNegateAssert(s): single assertions leave the solver and its cached model alone, batches reuse their guards
+void testAssertBatches()
+{
+    Z3Mgr mgr;
+    z3::context &ctx = mgr.getCtx();
+    z3::expr x = ctx.int_const("x");
+    std::string traceFile = "z3unittests.trace.smt2";
+    mgr.setTrace(traceFile);
+    mgr.addToSolver(x > 3);
+    Z3_model model = mgr.getModel();
+
+    CHECK(mgr.checkNegateAssert(x > 2));
+    CHECK(!mgr.checkNegateAssert(x > 5));
+    CHECK((Z3_model) mgr.getModel() == model);
+    CHECK(mgr.getSolver().assertions().size() == 1);
+    CHECK(Z3_solver_get_num_scopes(ctx, mgr.getSolver()) == 0);
+
+    z3::expr_vector qs(ctx);
+    qs.push_back(x > 2);
+    qs.push_back(x > 5);
+    qs.push_back(x >= 4);
+    qs.push_back(x < 0);
+    for (u32_t round = 0; round < 3; round++)
+    {
+        std::vector<AssertCheckResult> results = mgr.checkNegateAsserts(qs, true);
+        CHECK(results.size() == 4);
+        CHECK(results[0].holds() && !results[1].holds() && results[2].holds() && !results[3].holds());
+        CHECK(results[1].cex && results[1].cex->eval(x).get_numeral_int() <= 5);
+        CHECK(results[3].cex && results[3].cex->eval(x).get_numeral_int() >= 0);
+        CHECK(!results[0].cex);
+    }
+    CHECK(mgr.getSolver().assertions().size() == 1);
+
+    // the three batches declared the same four guards
+    mgr.setTrace("");
+    std::string trace = readFile(traceFile);
+    std::set<std::string> guards;
+    const std::string guardName = "__assert_guard_";
+    for (size_t pos = trace.find(guardName); pos != std::string::npos; pos = trace.find(guardName, pos + 1))
+    {
+        size_t end = trace.find_first_not_of("0123456789", pos + guardName.size());
+        guards.insert(trace.substr(pos, end - pos));
+    }
+    CHECK(guards.size() == 4);
+    std::remove(traceFile.c_str());
+}
+
+} // anonymous namespace
+
+int main()
+{
+    testIntervals();
+    testAssertBatches();
+    testUniqueAddresses();
+    testAsyncAsserts();
+    testVarIDs();
+    testRegionStores();
+    testGepObjIDs();
+    testInstrumentation();
+    testModelCache();
+    testSlicing();
+    testEvalValues();
+    testEncoding<IntEncoding>(INT64_MAX, false);
+    testEncoding<BV32Encoding>(INT32_MAX, true);
+    testEncoding<BV64Encoding>(INT64_MAX, true);
+    testSolverConfig();
+    testQueryCache();
+    testConstantPropagation();
+    testPool();
+    testTrace();
+    testFlatMem();
+    testUnsatCore();
+    testLightweightReset();
+    if (numFailed)
+    {
+        std::cerr << numFailed << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "all Z3 unit tests passed\n";
+    return 0;
+}